@@ -23,7 +23,127 @@
  * 
  * It accomplishes this via a volatile 'version' state, which monotonically
  * increases with each write. Overflow shouldn't affect safety.
+ * 
+ * On multicore hosts volatile alone is not enough, since the compiler and CPU
+ * can move the data copy across the version reads. Hosted builds with C11 or
+ * C++11 atomics therefore place acquire/release fences around the version
+ * accesses. Define ATOMIC_FENCE to 0 or 1 to override the automatic choice.
+ */
+
+#ifndef ATOMIC_FENCE
+#if defined(__AVR__) || !__STDC_HOSTED__
+#define ATOMIC_FENCE 0
+#elif defined(__cplusplus) && __cplusplus >= 201103L
+#define ATOMIC_FENCE 1
+#elif !defined(__cplusplus) && defined(__STDC_VERSION__) && __STDC_VERSION__ >= 201112L && !defined(__STDC_NO_ATOMICS__)
+#define ATOMIC_FENCE 1
+#else
+#define ATOMIC_FENCE 0
+#endif
+#endif
+
+/* _atomic_acquire(): later reads can't move before the preceding version read
+ * _atomic_release(): earlier writes can't move after the following version write
  */
+#if ATOMIC_FENCE && defined(__cplusplus)
+#include <atomic>
+#define _atomic_acquire() std::atomic_thread_fence(std::memory_order_acquire)
+#define _atomic_release() std::atomic_thread_fence(std::memory_order_release)
+#elif ATOMIC_FENCE
+#include <stdatomic.h>
+#define _atomic_acquire() atomic_thread_fence(memory_order_acquire)
+#define _atomic_release() atomic_thread_fence(memory_order_release)
+#elif defined(__GNUC__)
+/* single core: only the compiler can reorder the non-volatile data copy */
+#define _atomic_acquire() __asm__ __volatile__("" ::: "memory")
+#define _atomic_release() __asm__ __volatile__("" ::: "memory")
+#else
+#define _atomic_acquire()
+#define _atomic_release()
+#endif
+
+/* _atomic_pause(): hint to the CPU that this is a spin loop, which frees
+ * pipeline resources for a sibling hyperthread and saves power
+ */
+#if defined(__GNUC__) && (defined(__i386__) || defined(__x86_64__))
+#define _atomic_pause() __builtin_ia32_pause()
+#elif defined(__GNUC__) && (defined(__aarch64__) || (defined(__ARM_ARCH) && __ARM_ARCH >= 7))
+#define _atomic_pause() __asm__ __volatile__("yield" ::: "memory")
+#elif defined(_MSC_VER) && (defined(_M_IX86) || defined(_M_X64))
+#include <intrin.h>
+#define _atomic_pause() _mm_pause()
+#else
+#define _atomic_pause() ((void)0)
+#endif
+
+/**
+ * The maximum exponent of the reader backoff, ie. a spinning reader pauses
+ * at most 2^ATOMIC_BACKOFF_MAX times between version checks.
+ */
+#ifndef ATOMIC_BACKOFF_MAX
+#define ATOMIC_BACKOFF_MAX 6
+#endif
+
+/**
+ * Number of spins after which a POSIX reader calls sched_yield() instead of
+ * pausing, so a preempted writer can make progress. 0 disables yielding.
+ */
+#ifndef ATOMIC_YIELD_SPINS
+#if ATOMIC_FENCE && (defined(__unix__) || defined(__APPLE__))
+#define ATOMIC_YIELD_SPINS 16
+#else
+#define ATOMIC_YIELD_SPINS 0
+#endif
+#endif
+
+#if ATOMIC_YIELD_SPINS > 0
+#include <sched.h>
+#endif
+
+/**
+ * The reader backoff policy.
+ * 
+ * Invoked each time a reader finds a write in progress. Define atomic_backoff
+ * before including this file to plug in a different policy.
+ * 
+ * @param spins The number of times the reader already spun on this read.
+ */
+#ifndef atomic_backoff
+#define atomic_backoff(spins) _atomic_backoff(spins)
+#endif
+
+static inline
+void _atomic_backoff(unsigned spins) {
+    unsigned n;
+#if ATOMIC_YIELD_SPINS > 0
+    if (spins >= ATOMIC_YIELD_SPINS) {
+        sched_yield();
+        return;
+    }
+#endif
+    // bounded exponential backoff: 1, 2, 4, ... 2^ATOMIC_BACKOFF_MAX pauses
+    n = 1u << (spins < ATOMIC_BACKOFF_MAX ? spins : ATOMIC_BACKOFF_MAX);
+    while (n--)
+        _atomic_pause();
+}
+
+/**
+ * Read contention counters, enabled by defining ATOMIC_STATS.
+ * 
+ * 'retries' counts reads restarted because a write landed mid-read, and
+ * 'spins' counts version checks that found a write in progress. Counters are
+ * per translation unit and updated without synchronization, so they are
+ * approximate when several threads read concurrently.
+ */
+#ifdef ATOMIC_STATS
+static struct atomic_stats {
+    unsigned long retries;
+    unsigned long spins;
+} atomic_stats;
+#define _atomic_stat(field) (++atomic_stats.field)
+#else
+#define _atomic_stat(field) ((void)0)
+#endif
 
 /* FIXME: Multiple writers can possibly be supported with a spin
  * wait on _atomic_begin_write(), but this will require careful design to
@@ -43,36 +163,54 @@
     {\
         old = _atomic_begin_read(version);\
         x = *location;\
-    } while (old != _atomic_end_read(version)); \
+    } while (_atomic_retry(version, old)); \
     return x;
 
 static inline
 unsigned _atomic_begin_read(volatile unsigned* version) {
-    unsigned v;
+    unsigned v, spins = 0;
     // loop until version is even = no write in progress
     do
     {
         v = *version;
         if (0 == (v & 0x01)) break;   // odd version means write in progress
-        //Wait(); //FIXME: should spin wait?
+        _atomic_stat(spins);
+        atomic_backoff(spins++);
     } while (1);
+    // data reads must not be hoisted above the version read
+    _atomic_acquire();
     return v;
 }
 
 static inline
 unsigned _atomic_end_read(volatile unsigned *version) {
+    // data reads must complete before the version is checked again
+    _atomic_acquire();
     return *version;
 }
 
+static inline
+unsigned _atomic_retry(volatile unsigned *version, unsigned old) {
+    // a write started or completed since 'old' was read: start over
+    if (old == _atomic_end_read(version))
+        return 0;
+    _atomic_stat(retries);
+    return 1;
+}
+
 static inline
 void _atomic_begin_write(volatile unsigned *version) {
     // ++version odd: mark write in-progress
     *version |= 0x01;
+    // odd version must be visible before any data is written
+    _atomic_release();
 }
 
 static inline
 void _atomic_end_write(volatile unsigned *version) {
-    // ++version odd: mark write in-progress
+    // data must be visible before the version becomes even again
+    _atomic_release();
+    // ++version even: mark write complete
     *version += 1;
 }
 
@@ -84,7 +222,7 @@ void _atomic_end_write(volatile unsigned *version) {
  * @param location The address of the value to read.
  * @return The value at the given address.
  */
-static
+static inline
 uint16_t atomic_readu16(volatile unsigned* version, volatile uint16_t* location) {
     _atomic_read(uint16_t, version, location);
 }
@@ -95,7 +233,7 @@ uint16_t atomic_readu16(volatile unsigned* version, volatile uint16_t* location)
  * @param location The address of the value to read.
  * @return The value at the given address.
  */
-static
+static inline
 int16_t atomic_readi16(volatile unsigned* version, volatile int16_t* location) {
     _atomic_read(int16_t, version, location);
 }
@@ -106,7 +244,7 @@ int16_t atomic_readi16(volatile unsigned* version, volatile int16_t* location) {
  * @param location The address of the value to read.
  * @return The value at the given address.
  */
-static
+static inline
 uint32_t atomic_readu32(volatile unsigned* version, volatile uint32_t* location) {
     _atomic_read(uint32_t, version, location);
 }
@@ -117,7 +255,7 @@ uint32_t atomic_readu32(volatile unsigned* version, volatile uint32_t* location)
  * @param location The address of the value to read.
  * @return The value at the given address.
  */
-static
+static inline
 int32_t atomic_readi32(volatile unsigned* version, volatile int32_t* location) {
     _atomic_read(int32_t, version, location);
 }
@@ -128,7 +266,7 @@ int32_t atomic_readi32(volatile unsigned* version, volatile int32_t* location) {
  * @param location The address of the value to read.
  * @return The value at the given address.
  */
-static
+static inline
 uint64_t atomic_readu64(volatile unsigned* version, volatile uint64_t* location) {
     _atomic_read(uint64_t, version, location);
 }
@@ -139,7 +277,7 @@ uint64_t atomic_readu64(volatile unsigned* version, volatile uint64_t* location)
  * @param location The address of the value to read.
  * @return The value at the given address.
  */
-static
+static inline
 int64_t atomic_readi64(volatile unsigned* version, volatile int64_t* location) {
     _atomic_read(int64_t, version, location);
 }
@@ -151,7 +289,7 @@ int64_t atomic_readi64(volatile unsigned* version, volatile int64_t* location) {
  * @param location The address from which to copy.
  * @param bytes The number of bytes to copy.
  */
-static
+static inline
 void atomic_readv(volatile unsigned* version, void* output, volatile void* location, size_t bytes) {
     unsigned old;
     do
@@ -159,7 +297,37 @@ void atomic_readv(volatile unsigned* version, void* output, volatile void* locat
         old = _atomic_begin_read(version);
         // pretend it's const since we check for concurrent updates manually
         memcpy(output, (const void*)location, bytes);
-    } while (old != _atomic_end_read(version));
+    } while (_atomic_retry(version, old));
+}
+
+/**
+ * A single field of a multi-field atomic read or write.
+ */
+typedef struct atomic_iov {
+    volatile void* location;    /* the shared field */
+    void* buffer;               /* the private copy to read into or write from */
+    size_t bytes;               /* the size of the field */
+} atomic_iov;
+
+/**
+ * Atomically read several fields under one version check.
+ * 
+ * All fields are copied from the same write, so related values remain
+ * consistent with each other.
+ * @param version The version field shared by all fields.
+ * @param iov The fields to read.
+ * @param n The number of fields.
+ */
+static inline
+void atomic_gather(volatile unsigned* version, const atomic_iov* iov, size_t n) {
+    unsigned old;
+    size_t i;
+    do
+    {
+        old = _atomic_begin_read(version);
+        for (i = 0; i < n; ++i)
+            memcpy(iov[i].buffer, (const void*)iov[i].location, iov[i].bytes);
+    } while (_atomic_retry(version, old));
 }
 
 /***************** WRITE OPERATIONS ********************/
@@ -257,4 +425,238 @@ void atomic_writev(volatile unsigned* version, volatile void* location, const vo
     _atomic_end_write(version);
 }
 
+/**
+ * Atomically write several fields under one version.
+ * @param version The version field shared by all fields.
+ * @param iov The fields to write.
+ * @param n The number of fields.
+ */
+static inline
+void atomic_scatter(volatile unsigned* version, const atomic_iov* iov, size_t n) {
+    size_t i;
+    _atomic_begin_write(version);
+    for (i = 0; i < n; ++i)
+        memcpy((void*)iov[i].location, iov[i].buffer, iov[i].bytes);
+    _atomic_end_write(version);
+}
+
+/***************** TRIPLE BUFFERING ********************/
+
+/**
+ * Wait-free single-writer, single-reader publication of large values.
+ * 
+ * The caller owns three buffers, and atomic_tbuf tracks which one the writer
+ * is filling, which one the reader is using, and which one holds the latest
+ * complete value. The writer never waits and the reader never copies or
+ * retries, at the cost of 3x the storage of atomic_readv:
+ * 
+ * static struct snapshot bufs[3];
+ * static atomic_tbuf tb = ATOMIC_TBUF_INIT;
+ * 
+ * void writer() {
+ *    fill(&bufs[atomic_tbuf_back(&tb)]);
+ *    atomic_tbuf_publish(&tb);
+ * }
+ * void reader() {
+ *    const struct snapshot* s = &bufs[atomic_tbuf_front(&tb)];
+ *    // s is stable until the next atomic_tbuf_front()
+ * }
+ * 
+ * A zero-initialized atomic_tbuf has all three roles on buffer 0, so use
+ * ATOMIC_TBUF_INIT or call atomic_tbuf_init() before first use.
+ * 
+ * ATOMIC_TBUF is defined where the platform has an atomic byte exchange.
+ * Elsewhere the triple buffer is left out, and the rest of this header,
+ * eg. the seqlock reads clock.h relies on, is still available.
+ */
+
+/* _atomic_byte: a byte that can be exchanged atomically
+ * _atomic_xchg(p, v): atomically swap a byte, returning the old value
+ * _atomic_peek(p): read a byte without ordering
+ */
+#if ATOMIC_FENCE && defined(__cplusplus)
+#define ATOMIC_TBUF
+typedef std::atomic<unsigned char> _atomic_byte;
+#define _atomic_xchg(p, v) (p)->exchange((unsigned char)(v), std::memory_order_acq_rel)
+#define _atomic_peek(p) (p)->load(std::memory_order_relaxed)
+#elif ATOMIC_FENCE
+#define ATOMIC_TBUF
+typedef _Atomic unsigned char _atomic_byte;
+#define _atomic_xchg(p, v) atomic_exchange_explicit((p), (unsigned char)(v), memory_order_acq_rel)
+#define _atomic_peek(p) atomic_load_explicit((p), memory_order_relaxed)
+#else
+typedef volatile unsigned char _atomic_byte;
+#define _atomic_peek(p) (*(p))
+#if defined(__AVR__)
+#define ATOMIC_TBUF
+#include <util/atomic.h>
+/* save and restore SREG, so an ISR producer doesn't re-enable interrupts */
+static inline
+unsigned char _atomic_xchg(volatile unsigned char* p, unsigned char v) {
+    unsigned char old;
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+        old = *p;
+        *p = v;
+    }
+    return old;
+}
+#elif defined(__GNUC__)
+#define ATOMIC_TBUF
+#define _atomic_xchg(p, v) __atomic_exchange_n((p), (unsigned char)(v), __ATOMIC_ACQ_REL)
+#elif defined(_MSC_VER)
+#define ATOMIC_TBUF
+#include <intrin.h>
+#define _atomic_xchg(p, v) ((unsigned char)_InterlockedExchange8((volatile char*)(p), (char)(v)))
+#endif
+#endif
+
+#ifdef ATOMIC_TBUF
+
+typedef struct atomic_tbuf {
+    _atomic_byte mid;             /* latest published index | ATOMIC_TBUF_FRESH */
+    unsigned char back;           /* index owned by the writer */
+    unsigned char front;          /* index owned by the reader */
+} atomic_tbuf;
+
+#define ATOMIC_TBUF_FRESH 0x04
+
+/**
+ * Static initializer for an atomic_tbuf, equivalent to atomic_tbuf_init().
+ */
+#if ATOMIC_FENCE && defined(__cplusplus)
+#define ATOMIC_TBUF_INIT { { 1 }, 2, 0 }
+#else
+#define ATOMIC_TBUF_INIT { 1, 2, 0 }
+#endif
+
+/**
+ * Initialize a triple buffer.
+ * @param t The triple buffer state.
+ */
+static inline
+void atomic_tbuf_init(atomic_tbuf* t) {
+    t->front = 0;
+    t->mid = 1;
+    t->back = 2;
+}
+
+/**
+ * The index of the buffer the writer should fill next.
+ * @param t The triple buffer state.
+ * @return The index of the writer's buffer.
+ */
+static inline
+unsigned atomic_tbuf_back(atomic_tbuf* t) {
+    return t->back;
+}
+
+/**
+ * Publish the writer's buffer as the latest value.
+ * @param t The triple buffer state.
+ */
+static inline
+void atomic_tbuf_publish(atomic_tbuf* t) {
+    t->back = _atomic_xchg(&t->mid, t->back | ATOMIC_TBUF_FRESH) & 0x03;
+}
+
+/**
+ * Acquire the latest published buffer.
+ * @param t The triple buffer state.
+ * @return The index of the newest complete buffer, which the writer won't
+ *         touch until the next call.
+ */
+static inline
+unsigned atomic_tbuf_front(atomic_tbuf* t) {
+    if (_atomic_peek(&t->mid) & ATOMIC_TBUF_FRESH)
+        t->front = _atomic_xchg(&t->mid, t->front) & 0x03;
+    return t->front;
+}
+
+#endif
+
+/***************** C++ ATOMIC CELLS ********************/
+
+#ifdef __cplusplus
+
+/**
+ * Whether a type can bypass the version check.
+ * 
+ * True only if T fits in a native word and the platform loads and stores it
+ * with a single lock-free instruction. Always false with the volatile backend,
+ * eg. on 8-bit AVR where even 16-bit loads take several instructions.
+ */
+template<typename T>
+struct _atomic_native {
+#if ATOMIC_FENCE && __cplusplus >= 201703L
+    static const bool value = sizeof(T) <= sizeof(void*) && std::atomic<T>::is_always_lock_free;
+#elif ATOMIC_FENCE && defined(__GNUC__)
+    static const bool value = sizeof(T) <= sizeof(void*) && __atomic_always_lock_free(sizeof(T), 0);
+#else
+    static const bool value = false;
+#endif
+};
+
+/**
+ * A single-writer, multi-reader value whose strategy is chosen at compile time.
+ * 
+ * Word-sized lock-free types use plain atomic loads and stores, everything
+ * else falls back to the versioned read loop. There is no runtime dispatch:
+ * 
+ * static atomic_cell<uint32_t> ticks;   // native load/store on 32-bit ARM
+ * static atomic_cell<struct pos> pos;   // versioned copy everywhere
+ * 
+ * @param T The value type, which must be trivially copyable.
+ */
+template<typename T, bool native = _atomic_native<T>::value>
+struct atomic_cell;
+
+#if ATOMIC_FENCE
+template<typename T>
+struct atomic_cell<T, true> {
+    std::atomic<T> value;
+
+    /**
+     * Atomically read the value.
+     * @return The last value written.
+     */
+    T read() const {
+        return value.load(std::memory_order_acquire);
+    }
+
+    /**
+     * Atomically write the value.
+     * @param x The value to write.
+     */
+    void write(T x) {
+        value.store(x, std::memory_order_release);
+    }
+};
+#endif
+
+template<typename T>
+struct atomic_cell<T, false> {
+    volatile unsigned version;
+    T value;
+
+    /**
+     * Atomically read the value.
+     * @return The last value written.
+     */
+    T read() const {
+        T x;
+        atomic_readv(const_cast<volatile unsigned*>(&version), &x, const_cast<T*>(&value), sizeof(T));
+        return x;
+    }
+
+    /**
+     * Atomically write the value.
+     * @param x The value to write.
+     */
+    void write(const T& x) {
+        atomic_writev(&version, &value, &x, sizeof(T));
+    }
+};
+
+#endif
+
 #endif
\ No newline at end of file
@@ -34,6 +34,7 @@
  * Author: Sandro Magi <naasking@gmail.com>
  */
 
+#include <stdint.h>
 #include "clock.h"
 
 /**
@@ -76,6 +77,69 @@
  *    }
  * }
  * 
+ * # Bank Mode
+ * 
+ * Declare a btn_bankN variable for a group of up to N inputs sampled from a
+ * single port or word, and call btn_bankN_poll() at a fixed rate:
+ * 
+ * static btn_bank8 keys;
+ * 
+ * void loop() {
+ *    every (1, millis) {
+ *      uint8_t changed = btn_bank8_poll(&keys, PIND);
+ *      if (changed & keys.state) {
+ *        // some inputs went HIGH
+ *      }
+ *    }
+ * }
+ * 
+ * # Matrix Mode
+ * 
+ * Declare a btn_matrix for a key matrix of up to 8x8 keys, drive one row at
+ * a time and pass the column reading to btn_matrix_step(), which hands
+ * BTN_KEY_PRESS|key and key release events to a callback, eg. one feeding
+ * an equeue from evq.h:
+ * 
+ * static btn_matrix keypad;
+ * static equeue keys;
+ * 
+ * static unsigned key_emit(void* q, uint8_t ev) {
+ *    return equeue_add((volatile equeue*)q, ev);
+ * }
+ * void setup() {
+ *    PORTD = ~(1 << btn_matrix_init(&keypad, 4)); // drive the first row low
+ * }
+ * void loop() {
+ *    every (1, millis) {
+ *      uint8_t row = btn_matrix_step(&keypad, ~PINC & 0x0F, key_emit, &keys);
+ *      PORTD = ~(1 << row);                  // drive the next row low
+ *    }
+ *    while (equeue_size(&keys) > 0) {
+ *      uint8_t ev = equeue_next(&keys);
+ *      ...
+ *    }
+ * }
+ * 
+ * # Gestures
+ * 
+ * Feed a settled button state to btn_gesture_update() to recognize clicks,
+ * double clicks, long presses and auto-repeat:
+ * 
+ * static btn_sync btn1;
+ * static btn_gesture g1;
+ * 
+ * void loop() {
+ *    ms_t wake;
+ *    if (btn_poll(io_readb(PIN_X), &btn1, 7) || (btn_gesture_wake(&g1, &wake) && (long)(clock_ms() - wake) >= 0)) {
+ *      switch (btn_gesture_update(&g1, btn1.state, clock_ms())) {
+ *      case BTN_CLICK:  ...
+ *      case BTN_DOUBLE: ...
+ *      case BTN_LONG:   ...
+ *      case BTN_REPEAT: ...
+ *      }
+ *    }
+ * }
+ * 
  */
 
 /**
@@ -147,4 +211,346 @@ static unsigned btn_ready(unsigned bit, btn_async* btn, unsigned delay) {
   return 0;
 }
 
+/**
+ * Code block debouncing a bank of inputs with 2-bit vertical counters.
+ * 
+ * Each bit position has its own counter spread across cnt0 and cnt1, which
+ * resets whenever the sample matches the settled state. An input toggles
+ * after differing for 4 consecutive samples.
+ * @param T The word type.
+ * @param bank The bank state.
+ * @param sample The current sample of all inputs.
+ */
+#define _btn_bank_poll(T, bank, sample) \
+  T delta = (bank)->state ^ (sample); \
+  (bank)->cnt0 = ~(bank)->cnt0 & delta; \
+  (bank)->cnt1 = (bank)->cnt0 ^ (~(bank)->cnt1 & delta); \
+  delta &= ~((bank)->cnt0 | (bank)->cnt1); \
+  (bank)->state ^= delta; \
+  return delta;
+
+/**
+ * A bank of 8 inputs debounced together.
+ * 
+ * 'state' holds the settled level of each input. Zero-initialize, or set
+ * 'state' to the initial levels.
+ */
+typedef struct {
+  uint8_t state;
+  uint8_t cnt0;
+  uint8_t cnt1;
+} btn_bank8;
+
+/**
+ * A bank of 16 inputs debounced together.
+ */
+typedef struct {
+  uint16_t state;
+  uint16_t cnt0;
+  uint16_t cnt1;
+} btn_bank16;
+
+/**
+ * A bank of 32 inputs debounced together.
+ */
+typedef struct {
+  uint32_t state;
+  uint32_t cnt0;
+  uint32_t cnt1;
+} btn_bank32;
+
+/**
+ * A bank of 64 inputs debounced together.
+ */
+typedef struct {
+  uint64_t state;
+  uint64_t cnt0;
+  uint64_t cnt1;
+} btn_bank64;
+
+/**
+ * Debounce 8 inputs from a single port sample.
+ * 
+ * Call at a fixed rate, eg. every millisecond. Pressed edges are then
+ * 'changed & bank->state', and released edges 'changed & ~bank->state'.
+ * 
+ * @param bank   The bank state
+ * @param sample The current level of each input
+ * @return       The mask of inputs whose settled level changed.
+ */
+static inline uint8_t btn_bank8_poll(btn_bank8* bank, uint8_t sample) {
+  _btn_bank_poll(uint8_t, bank, sample);
+}
+
+/**
+ * Debounce 16 inputs from a single port sample.
+ * 
+ * @param bank   The bank state
+ * @param sample The current level of each input
+ * @return       The mask of inputs whose settled level changed.
+ */
+static inline uint16_t btn_bank16_poll(btn_bank16* bank, uint16_t sample) {
+  _btn_bank_poll(uint16_t, bank, sample);
+}
+
+/**
+ * Debounce 32 inputs from a single word sample.
+ * 
+ * @param bank   The bank state
+ * @param sample The current level of each input
+ * @return       The mask of inputs whose settled level changed.
+ */
+static inline uint32_t btn_bank32_poll(btn_bank32* bank, uint32_t sample) {
+  _btn_bank_poll(uint32_t, bank, sample);
+}
+
+/**
+ * Debounce 64 inputs from a single word sample.
+ * 
+ * @param bank   The bank state
+ * @param sample The current level of each input
+ * @return       The mask of inputs whose settled level changed.
+ */
+static inline uint64_t btn_bank64_poll(btn_bank64* bank, uint64_t sample) {
+  _btn_bank_poll(uint64_t, bank, sample);
+}
+
+/**
+ * The maximum number of rows of a key matrix, no greater than 8.
+ */
+#ifndef BTN_MATRIX_ROWS
+#define BTN_MATRIX_ROWS 8
+#endif
+
+/**
+ * Matrix key events: the key index is row * 8 + column, with the top bit
+ * set when the key was pressed and clear when it was released.
+ */
+#define BTN_KEY_PRESS 0x80
+#define btn_key(row, col) (((row) << 3) | (col))
+#define btn_key_index(ev) ((ev) & 0x3F)
+#define btn_key_pressed(ev) ((ev) & BTN_KEY_PRESS)
+
+/**
+ * Receives a matrix key event, returning zero if it can't be taken now, eg.
+ * because a queue is full, in which case it's offered again later.
+ */
+typedef unsigned (*btn_emit)(void* ctx, uint8_t ev);
+
+/**
+ * A key matrix of up to BTN_MATRIX_ROWS rows and 8 columns.
+ * 
+ * Each row is debounced as a btn_bank8, so a key settles after it's read
+ * the same way on 4 consecutive scans. 'sent' tracks the key states already
+ * reported, so events the callback couldn't take are retried on the next
+ * scan of that row. 'ghost' has a bit set for each row whose keys are
+ * currently ambiguous. A zero-initialized matrix scans BTN_MATRIX_ROWS rows.
+ */
+typedef struct {
+  btn_bank8 keys[BTN_MATRIX_ROWS];
+  uint8_t sent[BTN_MATRIX_ROWS];
+  uint8_t nrows;
+  uint8_t row;
+  uint8_t ghost;
+} btn_matrix;
+
+/**
+ * Initialize a key matrix.
+ * 
+ * @param m     The key matrix
+ * @param nrows The number of rows
+ * @return      The first row to drive.
+ */
+static uint8_t btn_matrix_init(btn_matrix* m, uint8_t nrows) {
+  uint8_t i;
+  for (i = 0; i < BTN_MATRIX_ROWS; ++i) {
+    m->keys[i].state = m->keys[i].cnt0 = m->keys[i].cnt1 = 0;
+    m->sent[i] = 0;
+  }
+  m->nrows = nrows;
+  m->row = 0;
+  m->ghost = 0;
+  return 0;
+}
+
+/**
+ * Scan one row of a key matrix.
+ * 
+ * Call at a fixed rate, eg. every millisecond, with the columns read while
+ * the row last returned was driven, then drive the returned row until the
+ * next call. A full scan thus takes 'nrows' calls, and each call costs one
+ * debounce step, at most 'nrows' ANDs for ghost detection, and at most 8
+ * 'emit' calls.
+ * 
+ * Without diodes, pressing three corners of a rectangle makes the fourth
+ * read as pressed too. So while the pressed keys of the current row share
+ * two or more columns with another row, its presses aren't reported and the
+ * row's bit in m->ghost is set. Releases are always reported.
+ * 
+ * @param m    The key matrix
+ * @param cols The columns of the current row, with a bit set for each pressed key
+ * @param emit The callback receiving key events
+ * @param ctx  The callback's context
+ * @return     The next row to drive.
+ */
+static uint8_t btn_matrix_step(btn_matrix* m, uint8_t cols, btn_emit emit, void* ctx) {
+  uint8_t r = m->row, i, diff, keys;
+  uint8_t nrows = m->nrows ? m->nrows : BTN_MATRIX_ROWS;
+  btn_bank8_poll(&m->keys[r], cols);
+  keys = m->keys[r].state;
+  /* only a row with 2 or more pressed keys can be ghosted */
+  m->ghost &= ~(1 << r);
+  if (keys & (keys - 1)) {
+    for (i = 0; i < nrows; ++i) {
+      uint8_t x = keys & m->keys[i].state;
+      if (i != r && (x & (x - 1))) {
+        m->ghost |= 1 << r;
+        break;
+      }
+    }
+  }
+  diff = keys ^ m->sent[r];
+  if (m->ghost & (1 << r)) {
+    diff &= m->sent[r];
+  }
+  for (i = 0; diff; ++i, diff >>= 1) {
+    if (diff & 1) {
+      uint8_t bit = 1 << i;
+      if (!emit(ctx, (keys & bit ? BTN_KEY_PRESS : 0) | btn_key(r, i))) {
+        break;
+      }
+      m->sent[r] ^= bit;
+    }
+  }
+  m->row = r + 1 < nrows ? r + 1 : 0;
+  return m->row;
+}
+
+/**
+ * Gesture timing in milliseconds: how long a press must be held to count as
+ * a long press, how long after a click to wait for a second one, and the
+ * auto-repeat period of a held button.
+ */
+#ifndef BTN_LONG_MS
+#define BTN_LONG_MS 500
+#endif
+#ifndef BTN_DOUBLE_MS
+#define BTN_DOUBLE_MS 250
+#endif
+#ifndef BTN_REPEAT_MS
+#define BTN_REPEAT_MS 100
+#endif
+
+/**
+ * Gesture events.
+ */
+#define BTN_NONE   0
+#define BTN_CLICK  1
+#define BTN_DOUBLE 2
+#define BTN_LONG   3
+#define BTN_REPEAT 4
+
+/* gesture recognizer phases */
+#define _BTN_IDLE  0
+#define _BTN_DOWN  1
+#define _BTN_UP    2
+#define _BTN_DOWN2 3
+#define _BTN_HELD  4
+
+/**
+ * Per-button gesture state, zero-initialized.
+ */
+typedef struct {
+  ms_t since;
+  uint8_t phase;
+} btn_gesture;
+
+/**
+ * Update a button's gesture recognizer.
+ * 
+ * Call whenever the settled button state changes, eg. when btn_poll() or
+ * btn_ready() return true, and at the time given by btn_gesture_wake().
+ * Extra calls are harmless.
+ * 
+ * A press held for BTN_LONG_MS yields BTN_LONG, then BTN_REPEAT every
+ * BTN_REPEAT_MS until released. A press released early yields BTN_CLICK
+ * after BTN_DOUBLE_MS, unless a second press arrives first, in which case
+ * releasing it yields BTN_DOUBLE.
+ * 
+ * @param g       The gesture state
+ * @param pressed Non-zero if the button is currently pressed
+ * @param now     The current time, eg. clock_ms()
+ * @return        The gesture event, or BTN_NONE.
+ */
+static uint8_t btn_gesture_update(btn_gesture* g, unsigned pressed, ms_t now) {
+  ms_t elapsed = (ms_t)(now - g->since);
+  switch (g->phase) {
+  case _BTN_IDLE:
+    if (pressed) {
+      g->phase = _BTN_DOWN;
+      g->since = now;
+    }
+    break;
+  case _BTN_DOWN:
+    if (!pressed) {
+      g->phase = _BTN_UP;
+      g->since = now;
+    } else if (elapsed >= BTN_LONG_MS) {
+      g->phase = _BTN_HELD;
+      g->since = now;
+      return BTN_LONG;
+    }
+    break;
+  case _BTN_UP:
+    if (pressed) {
+      g->phase = _BTN_DOWN2;
+      g->since = now;
+    } else if (elapsed >= BTN_DOUBLE_MS) {
+      g->phase = _BTN_IDLE;
+      return BTN_CLICK;
+    }
+    break;
+  case _BTN_DOWN2:
+    if (!pressed) {
+      g->phase = _BTN_IDLE;
+      return BTN_DOUBLE;
+    }
+    break;
+  case _BTN_HELD:
+    if (!pressed) {
+      g->phase = _BTN_IDLE;
+    } else if (elapsed >= BTN_REPEAT_MS) {
+      g->since = now;
+      return BTN_REPEAT;
+    }
+    break;
+  }
+  return BTN_NONE;
+}
+
+/**
+ * The next time a gesture recognizer needs updating absent button changes.
+ * 
+ * Lets a scheduler sleep until then rather than polling.
+ * 
+ * @param g    The gesture state
+ * @param when Set to the deadline, if any
+ * @return     True if there is a deadline, false if only a button change matters.
+ */
+static unsigned btn_gesture_wake(const btn_gesture* g, ms_t* when) {
+  switch (g->phase) {
+  case _BTN_DOWN:
+    *when = g->since + BTN_LONG_MS;
+    return 1;
+  case _BTN_UP:
+    *when = g->since + BTN_DOUBLE_MS;
+    return 1;
+  case _BTN_HELD:
+    *when = g->since + BTN_REPEAT_MS;
+    return 1;
+  default:
+    return 0;
+  }
+}
+
 #endif
\ No newline at end of file
@@ -37,7 +37,55 @@
 /**
  * @file clock.h
  * Clock functions.
+ * 
+ * The platform clocks are typically 32 bits and wrap, after about 49 days
+ * for clock_ms() and 71 minutes for clock_us(). clock_ms64() and
+ * clock_us64() extend them to 64 bits as long as clock_sync() is called at
+ * least once per wrap period:
+ * 
+ * ISR(TIMER2_OVF_vect) {
+ *    clock_sync();
+ * }
+ * 
+ * void loop() {
+ *    uint64_t t = clock_ms64();
+ * }
+ * 
+ * The clock and profiling state is shared by every source file, so define
+ * CLOCK_IMPL in exactly one of them, before clock.h or any header that
+ * includes it:
+ * 
+ * #define CLOCK_IMPL
+ * #include "clock.h"
+ * 
+ * clock_cycles() reads the finest counter available for timing short code
+ * sections, and with CLOCK_PROFILE defined, PROFILE_BEGIN/PROFILE_END
+ * accumulate per-section statistics:
+ * 
+ * void setup() {
+ *    clock_cycles_init();
+ *    clock_cycles_calibrate(10);
+ * }
+ * void loop() {
+ *    PROFILE_BEGIN(update);
+ *    // code to profile
+ *    PROFILE_END(update);
+ * }
+ */
+
+#include <stdint.h>
+#include <string.h>
+#include "atomic.h"
+
+/*
+ * Shared state is declared in every source file and defined in the one that
+ * defines CLOCK_IMPL.
  */
+#ifdef CLOCK_IMPL
+#define _clock_shared
+#else
+#define _clock_shared extern
+#endif
 
 /**
  * Clock time in milliseconds.
@@ -46,15 +94,322 @@
  */
 #define clock_ms() _clock_ms()
 
-// /**
-//  * Clock time in microseconds.
-//  * 
-//  * @return Time in microseconds, type is unsigned long
-//  */
-// #define clock_us() _clock_ms()
+/**
+ * Clock time in microseconds.
+ * 
+ * @return Time in microseconds, type is ms_t
+ */
+#define clock_us() _clock_us()
+
+/**
+ * The state extending a 32-bit clock: the reading at the last clock_sync()
+ * and the number of times the clock had wrapped by then.
+ */
+struct clock_ext {
+  uint32_t last;
+  uint32_t hi;
+};
+
+/**
+ * The extended clocks, accessed atomically through _clock_version.
+ */
+struct clock_state {
+  struct clock_ext ms;
+  struct clock_ext us;
+};
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+_clock_shared volatile unsigned _clock_version;
+_clock_shared volatile struct clock_state _clock_state;
+#ifdef __cplusplus
+}
+#endif
+
+/**
+ * Extend a 32-bit clock reading with its wrap count.
+ * 
+ * Reads the state before the clock, so any reading taken after it is at or
+ * past the last sync, and is behind it only if the clock has since wrapped.
+ * 
+ * @param now The clock reading, evaluated twice, so not a live clock
+ * @param ext The clock state at the last sync
+ * @return The 64-bit clock time
+ */
+#define _clock_extend(now, ext) \
+  (((uint64_t)((ext).hi + ((uint32_t)(now) < (ext).last)) << 32) | (uint32_t)(now))
+
+/**
+ * Advance a clock's wrap count.
+ * @param now The clock reading
+ * @param ext The clock state
+ */
+#define _clock_advance(now, ext) \
+  (ext).hi += (uint32_t)(now) < (ext).last; \
+  (ext).last = (uint32_t)(now);
+
+/**
+ * Record the current clock readings, tracking wraparound.
+ * 
+ * Call at least once per wrap period, from a single context that readers of
+ * clock_ms64() and clock_us64() can't interrupt, eg. a periodic timer
+ * interrupt or the main loop when only the main loop reads the clock.
+ */
+static inline
+void clock_sync(void) {
+  struct clock_ext ms;
+  uint32_t now;
+  /* the only writer, so the state can be read directly */
+  memcpy(&ms, (const void*)&_clock_state.ms, sizeof(ms));
+  now = (uint32_t)clock_ms();
+  _clock_advance(now, ms);
+  atomic_writev(&_clock_version, &_clock_state.ms, &ms, sizeof(ms));
+#ifdef _clock_us
+  {
+    struct clock_ext us;
+    memcpy(&us, (const void*)&_clock_state.us, sizeof(us));
+    now = (uint32_t)clock_us();
+    _clock_advance(now, us);
+    atomic_writev(&_clock_version, &_clock_state.us, &us, sizeof(us));
+  }
+#endif
+}
+
+/**
+ * Clock time in milliseconds, extended to 64 bits.
+ * @return Time in milliseconds since the clock started
+ */
+static inline
+uint64_t clock_ms64(void) {
+  struct clock_ext ms;
+  uint32_t now;
+  atomic_readv(&_clock_version, &ms, &_clock_state.ms, sizeof(ms));
+  now = (uint32_t)clock_ms();
+  return _clock_extend(now, ms);
+}
+
+#ifdef _clock_us
+/**
+ * Clock time in microseconds, extended to 64 bits.
+ * @return Time in microseconds since the clock started
+ */
+static inline
+uint64_t clock_us64(void) {
+  struct clock_ext us;
+  uint32_t now;
+  atomic_readv(&_clock_version, &us, &_clock_state.us, sizeof(us));
+  now = (uint32_t)clock_us();
+  return _clock_extend(now, us);
+}
+#endif
+
+/**
+ * The cycle counter, overridable by defining _clock_cycles() and cycles_t:
+ * DWT CYCCNT on Cortex-M3 and up, the time stamp counter on x86, the
+ * virtual counter on AArch64, and timer 1 on AVR, which counts CPU cycles
+ * only when running without a prescaler. Other targets fall back to
+ * clock_us(), or clock_ms() where that's the only clock.
+ */
+#ifndef _clock_cycles
+#if defined(__AVR__)
+#include <avr/io.h>
+typedef uint16_t cycles_t;
+#define _clock_cycles() TCNT1
+#elif defined(__ARM_ARCH_7M__) || defined(__ARM_ARCH_7EM__) || defined(__ARM_ARCH_8M_MAIN__)
+typedef uint32_t cycles_t;
+#define _CLOCK_DWT_CTRL   (*(volatile uint32_t*)0xE0001000)
+#define _CLOCK_DWT_CYCCNT (*(volatile uint32_t*)0xE0001004)
+#define _CLOCK_DEMCR      (*(volatile uint32_t*)0xE000EDFC)
+#define _clock_cycles() _CLOCK_DWT_CYCCNT
+#elif defined(__x86_64__) || defined(__i386__) || defined(_M_X64) || defined(_M_IX86)
+#ifdef _MSC_VER
+#include <intrin.h>
+#else
+#include <x86intrin.h>
+#endif
+typedef uint64_t cycles_t;
+#define _clock_cycles() __rdtsc()
+#elif defined(__aarch64__)
+typedef uint64_t cycles_t;
+static inline
+cycles_t _clock_cntvct(void) {
+  uint64_t x;
+  __asm__ volatile("mrs %0, cntvct_el0" : "=r"(x));
+  return x;
+}
+#define _clock_cycles() _clock_cntvct()
+#elif defined(_clock_us)
+typedef ms_t cycles_t;
+#define _clock_cycles() _clock_us()
+#else
+typedef ms_t cycles_t;
+#define _clock_cycles() _clock_ms()
+#endif
+#endif
+
+/**
+ * Cycle counter time.
+ * 
+ * Differences of two readings are correct across wraparound as long as they
+ * are computed as cycles_t and span less than one wrap.
+ * 
+ * @return Time in cycles, type is cycles_t
+ */
+#define clock_cycles() _clock_cycles()
+
+/**
+ * Enable the cycle counter where it's off by default.
+ */
+static inline
+void clock_cycles_init(void) {
+#ifdef _CLOCK_DWT_CYCCNT
+  _CLOCK_DEMCR |= 1UL << 24;     /* TRCENA */
+  _CLOCK_DWT_CYCCNT = 0;
+  _CLOCK_DWT_CTRL |= 1;          /* CYCCNTENA */
+#endif
+}
+
+/**
+ * Nanoseconds per cycle in 16.16 fixed point.
+ */
+#ifdef __cplusplus
+extern "C" {
+#endif
+_clock_shared uint32_t _clock_cycle_ns;
+#ifdef __cplusplus
+}
+#endif
+
+/**
+ * Set the cycle counter frequency.
+ * @param hz The counter frequency, eg. F_CPU
+ */
+static inline
+void clock_cycles_hz(uint32_t hz) {
+  _clock_cycle_ns = (uint32_t)((1000000000ULL << 16) / hz);
+}
+
+/**
+ * Measure the cycle counter frequency against clock_ms().
+ * 
+ * Busy waits for 'ms' milliseconds. The counter may wrap during the wait,
+ * but must not wrap twice between two consecutive reads.
+ * 
+ * @param ms The calibration time in milliseconds
+ */
+static inline
+void clock_cycles_calibrate(unsigned ms) {
+  uint64_t total = 0;
+  cycles_t last = clock_cycles();
+  uint32_t start = (uint32_t)clock_ms();
+  while ((uint32_t)clock_ms() - start < ms) {
+    cycles_t now = clock_cycles();
+    total += (cycles_t)(now - last);
+    last = now;
+  }
+  if (total > 0) {
+    _clock_cycle_ns = (uint32_t)(((uint64_t)ms * 1000000ULL << 16) / total);
+  }
+}
+
+/**
+ * Convert cycles to nanoseconds, once calibrated.
+ * @param cycles The number of cycles
+ * @return The time in nanoseconds
+ */
+static inline
+uint64_t clock_cycles_ns(cycles_t cycles) {
+  return (uint64_t)cycles * _clock_cycle_ns >> 16;
+}
+
+#ifdef CLOCK_PROFILE
+
+/**
+ * The maximum number of profiled sections.
+ */
+#ifndef CLOCK_PROFILE_MAX
+#define CLOCK_PROFILE_MAX 16
+#endif
+
+/**
+ * Statistics of a profiled section, in cycles.
+ */
+struct clock_profile {
+  const char* name;
+  cycles_t min;
+  cycles_t max;
+  uint64_t total;
+  uint32_t count;
+};
+
+/**
+ * The profiled sections, in the order first run.
+ */
+#ifdef __cplusplus
+extern "C" {
+#endif
+_clock_shared struct clock_profile clock_profiles[CLOCK_PROFILE_MAX];
+_clock_shared unsigned clock_nprofiles;
+#ifdef __cplusplus
+}
+#endif
+
+/**
+ * Record one run of a profiled section.
+ * 
+ * @param slot   The section's cached table entry, looked up on first use
+ * @param name   The section name
+ * @param cycles The duration of the run
+ */
+static
+void clock_profile_add(struct clock_profile** slot, const char* name, cycles_t cycles) {
+  struct clock_profile* p = *slot;
+  if (p == NULL) {
+    unsigned i;
+    for (i = 0; i < clock_nprofiles && strcmp(clock_profiles[i].name, name) != 0; ++i);
+    if (i == clock_nprofiles) {
+      if (i == CLOCK_PROFILE_MAX) {
+        return;
+      }
+      ++clock_nprofiles;
+      clock_profiles[i].name = name;
+      clock_profiles[i].min = (cycles_t)~(cycles_t)0;
+    }
+    p = *slot = &clock_profiles[i];
+  }
+  if (cycles < p->min) {
+    p->min = cycles;
+  }
+  if (cycles > p->max) {
+    p->max = cycles;
+  }
+  p->total += cycles;
+  ++p->count;
+}
+
+/**
+ * Start a profiled section.
+ * 
+ * Must be followed by PROFILE_END with the same name in the same scope.
+ * @param name The section name, an identifier
+ */
+#define PROFILE_BEGIN(name) \
+  static struct clock_profile* _clock_prof_##name; \
+  cycles_t _clock_prof_start_##name = clock_cycles()
+
+/**
+ * End a profiled section.
+ * @param name The section name, an identifier
+ */
+#define PROFILE_END(name) \
+  clock_profile_add(&_clock_prof_##name, #name, (cycles_t)(clock_cycles() - _clock_prof_start_##name))
+
+#else
+
+#define PROFILE_BEGIN(name)
+#define PROFILE_END(name)
 
-// #ifndef _clock_ms
-// #define _clock_ms() 0
-// #endif
+#endif
 
 #endif
\ No newline at end of file
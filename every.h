@@ -43,18 +43,122 @@
  *    every (5, millis) {
  *      // do something
  *    }
+ *    every_phase (100, 50, millis) {
+ *      // runs 50ms out of phase with other 100ms blocks
+ *    }
  * }
  */
 
+/**
+ * Overrun policies, for when a block runs late by one or more periods:
+ * EVERY_CATCHUP runs it once per missed period on consecutive passes,
+ * EVERY_SKIP drops the missed periods and keeps the original phase, and
+ * EVERY_DRIFT restarts the period from the time it actually ran.
+ */
+#define EVERY_CATCHUP 0
+#define EVERY_SKIP    1
+#define EVERY_DRIFT   2
+
+/**
+ * The overrun policy of every() and every_phase().
+ */
+#ifndef EVERY_POLICY
+#define EVERY_POLICY EVERY_CATCHUP
+#endif
+
+/**
+ * The number of distinct phases every_stagger() spreads blocks across.
+ */
+#ifndef EVERY_SLOTS
+#define EVERY_SLOTS 8
+#endif
+
+#define _every_cat(a, b) a##b
+#define _every_var(line) _every_cat(_every_, line)
+
+#ifdef __COUNTER__
+#define _every_slot (__COUNTER__ % EVERY_SLOTS)
+#else
+#define _every_slot (__LINE__ % EVERY_SLOTS)
+#endif
+
+/**
+ * Check whether a periodic block is due, and schedule its next run.
+ * 
+ * @param last   The time the block last ran, or its phase before its first run
+ * @param now    The current time
+ * @param x      The period
+ * @param policy The overrun policy
+ * @return 1 if the block should run, 0 otherwise
+ */
+static inline int _every_due(unsigned long *last, unsigned long now, unsigned long x, unsigned char policy) {
+  /* unsigned elapsed time is wrap-safe; 'last' is only ever ahead of 'now'
+   * before the clock first reaches a block's phase, by less than a period */
+  unsigned long elapsed = now - *last;
+  if (elapsed < x || 0UL - elapsed < x) {
+    return 0;
+  }
+  switch (policy) {
+  case EVERY_SKIP:
+    *last += elapsed / x * x;
+    break;
+  case EVERY_DRIFT:
+    *last = now;
+    break;
+  default:
+    *last += x;
+    break;
+  }
+  return 1;
+}
+
+/**
+ * Declare a periodic code block with an overrun policy.
+ * 
+ * Runs every 'x' * 'units' of time, first at time 'x' + 'offset'.
+ * @param x      The number of time units
+ * @param offset The phase of the block within its period, a constant less than 'x'
+ * @param units  The time base, millis or micros on Arduino (clock_ms or clock_us)
+ * @param policy EVERY_CATCHUP, EVERY_SKIP or EVERY_DRIFT
+ */
+#define every_policy(x, offset, units, policy) \
+  static unsigned long _every_var(__LINE__) = (offset); \
+  if (_every_due(&_every_var(__LINE__), units(), (x), (policy)))
+
+/**
+ * Declare a periodic code block at a given phase.
+ * 
+ * Blocks with the same period but different offsets run on different loop
+ * passes, eg. every_phase(100, 50, millis) runs halfway between the runs of
+ * every(100, millis).
+ * @param x      The number of time units
+ * @param offset The phase of the block within its period, a constant less than 'x'
+ * @param units  The time base, millis or micros on Arduino (clock_ms or clock_us)
+ */
+#define every_phase(x, offset, units) every_policy(x, offset, units, EVERY_POLICY)
+
+/**
+ * Declare a periodic code block at an automatically assigned phase.
+ * 
+ * Each block gets the next of EVERY_SLOTS evenly spaced phases of its
+ * period, so blocks sharing a period don't all run on the same pass.
+ * @param x The number of time units, a constant
+ * @param units The time base, millis or micros on Arduino (clock_ms or clock_us)
+ */
+#define every_stagger(x, units) every_phase(x, (x) * _every_slot / EVERY_SLOTS, units)
+
 /**
  * Declare a periodic code block.
  * 
  * Defines a block of code that runs periodically every 'x' * 'units' of time.
+ * Define EVERY_STAGGER to spread blocks across phases as with every_stagger().
  * @param x The number of time units
  * @param units The time base, millis or micros on Arduino (clock_ms or clock_us)
  */
-#define every(x, units) \
-  static unsigned long _every##_##__LINE__ = 0; \
-  if (units() - _every##_##__LINE__ >= (x) && (_every##_##__LINE__ += (x),1))
+#ifdef EVERY_STAGGER
+#define every(x, units) every_stagger(x, units)
+#else
+#define every(x, units) every_phase(x, 0, units)
+#endif
 
 #endif
\ No newline at end of file
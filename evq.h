@@ -2,6 +2,8 @@
 #ifndef EVQ_H
 #define EVQ_H
 
+#include <stdbool.h>
+#include <stdint.h>
 #include "isr.h"
 
 //WARNING: experimental
@@ -75,4 +77,95 @@ bool evq_pop(volatile evq* e, unsigned n, unsigned *x) {
     return 0;
 }
 
+/*
+ * Byte event queues: a FIFO ring buffer of up to EQUEUE_SIZE byte-sized
+ * events, for when events don't fit the bit-packed evq. Like evq it is safe
+ * to add to from interrupts as long as the equeue is declared volatile.
+ */
+
+/**
+ * The capacity of an equeue, which must be a power of two no greater than 128.
+ */
+#ifndef EQUEUE_SIZE
+#define EQUEUE_SIZE 16
+#endif
+
+typedef struct equeue {
+    uint8_t evts[EQUEUE_SIZE];
+    uint8_t head;
+    uint8_t tail;
+} equeue;
+
+/**
+ * The number of events in the queue.
+ * @param q The event queue
+ */
+#define equeue_size(q) ((uint8_t)((q)->tail - (q)->head))
+
+/**
+ * Add an event to the back of the queue.
+ * @param q The event queue
+ * @param x The event to add
+ * @return True if the event was added, false if the queue is full
+ */
+static //inline
+bool equeue_add(volatile equeue* q, uint8_t x) {
+    isr_off();
+    if (equeue_size(q) < EQUEUE_SIZE) {
+        q->evts[q->tail++ & (EQUEUE_SIZE - 1)] = x;
+        isr_on();
+        return 1;
+    }
+    isr_on();
+    return 0;
+}
+
+/**
+ * Add an event to the front of the queue, so it's removed next.
+ * @param q The event queue
+ * @param x The event to add
+ * @return True if the event was added, false if the queue is full
+ */
+static //inline
+bool equeue_push(volatile equeue* q, uint8_t x) {
+    isr_off();
+    if (equeue_size(q) < EQUEUE_SIZE) {
+        q->evts[--q->head & (EQUEUE_SIZE - 1)] = x;
+        isr_on();
+        return 1;
+    }
+    isr_on();
+    return 0;
+}
+
+/**
+ * Remove the event at the front of the queue.
+ * @param q The event queue
+ * @param[out] x The event removed from the queue
+ * @return True if an event was removed, false if the queue is empty
+ */
+static //inline
+bool equeue_pop(volatile equeue* q, uint8_t* x) {
+    isr_off();
+    if (equeue_size(q) > 0) {
+        *x = q->evts[q->head++ & (EQUEUE_SIZE - 1)];
+        isr_on();
+        return 1;
+    }
+    isr_on();
+    return 0;
+}
+
+/**
+ * Remove the event at the front of the queue.
+ * @param q The event queue
+ * @return The event removed, or 0 if the queue is empty
+ */
+static inline
+uint8_t equeue_next(volatile equeue* q) {
+    uint8_t x = 0;
+    equeue_pop(q, &x);
+    return x;
+}
+
 #endif
\ No newline at end of file
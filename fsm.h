@@ -1,6 +1,10 @@
 #ifndef FSM_H
 #define FSM_H
 
+#include <stdint.h>
+#include <string.h>
+#include "evq.h"
+
 // WARNING: experimental
 //
 // Set of macros defining an EDSL for simple finite state machines. Not
@@ -20,9 +24,571 @@
 #define CAT(x,y) x##_##y
 #define WHEN(state, evt) CAT(state, evt): case MRG(state, evt)
 #define JUMP(state, evt) goto CAT(state, evt)
-#define STEP(x) switch(MRG((x).state, equeue_next((x).evts))))
-#define PENDING(x) (x).equeue.i
-#define EVENT(x, e) equeue_add((x).evts, e)
+#define STEP(x) switch(MRG((x).state, equeue_next(&(x).evts)))
+#define PENDING(x) equeue_size(&(x).evts)
+#define EVENT(x, e) equeue_add(&(x).evts, e)
 #define NEXT(x, state) (x).state = state
 
+/*
+ * Transition tracing.
+ *
+ * Defining FSM_TRACE records every dispatched event as a (time, state, event,
+ * next state) record in a fixed ring buffer of the last FSM_TRACE_SIZE
+ * transitions, at the cost of a few stores per transition. fsm_define()
+ * machines record into m_trace, and hsm machines into the buffer assigned to
+ * their 'trace' field.
+ *
+ * A captured trace can be copied off the device and fed back through the same
+ * machine on a host with fsm_replay() or hsm_replay() for deterministic
+ * reproduction, and summarized with fsm_trace_stats().
+ */
+
+/**
+ * The number of records kept, which must be a power of two.
+ */
+#ifndef FSM_TRACE_SIZE
+#define FSM_TRACE_SIZE 32
+#endif
+
+/**
+ * The trace timestamp source.
+ */
+#ifndef FSM_TRACE_CLOCK
+#define FSM_TRACE_CLOCK() clock_ms()
+#endif
+
+/**
+ * A single traced transition.
+ */
+struct fsm_record {
+    uint32_t time;
+    uint8_t state;
+    uint8_t event;
+    uint8_t next;
+};
+
+/**
+ * A ring buffer of the most recent transitions.
+ */
+typedef struct fsm_trace {
+    struct fsm_record recs[FSM_TRACE_SIZE];
+    unsigned i;         /* the next record to overwrite */
+    uint8_t full;       /* whether the buffer has wrapped */
+} fsm_trace;
+
+#ifdef FSM_TRACE
+#include "clock.h"
+
+/**
+ * Record a transition.
+ * @param t The trace buffer.
+ * @param state The state the event was dispatched in.
+ * @param event The event.
+ * @param next The state after the event.
+ */
+static inline
+void fsm_trace_add(fsm_trace* t, uint8_t state, uint8_t event, uint8_t next) {
+    struct fsm_record* r = &t->recs[t->i];
+    r->time = (uint32_t)FSM_TRACE_CLOCK();
+    r->state = state;
+    r->event = event;
+    r->next = next;
+    t->i = (t->i + 1) & (FSM_TRACE_SIZE - 1);
+    t->full |= t->i == 0;
+}
+
+#define _fsm_trace_decl(m) static fsm_trace m##_trace;
+#define _fsm_trace(t, s, e, n) fsm_trace_add(t, s, e, n)
+#else
+#define _fsm_trace_decl(m)
+#define _fsm_trace(t, s, e, n) ((void)0)
+#endif
+
+/**
+ * The number of records in a trace.
+ * @param t The trace buffer.
+ */
+#define fsm_trace_len(t) ((t)->full ? FSM_TRACE_SIZE : (t)->i)
+
+/**
+ * A record of a trace, oldest first.
+ * @param t The trace buffer.
+ * @param k The record number, less than fsm_trace_len(t).
+ * @return The k-th oldest record.
+ */
+static inline
+const struct fsm_record* fsm_trace_at(const fsm_trace* t, unsigned k) {
+    return &t->recs[((t->full ? t->i : 0) + k) & (FSM_TRACE_SIZE - 1)];
+}
+
+/**
+ * Summarize a trace.
+ *
+ * Counts are added per (state, event) transition, and dwell times per state
+ * are measured from the record entering the state to the next record.
+ * @param t The trace buffer.
+ * @param nevents The number of events in the machine.
+ * @param count Transition counts, nstates * nevents entries, or NULL.
+ * @param dwell Total time spent per state, nstates entries, or NULL.
+ */
+static void fsm_trace_stats(const fsm_trace* t, uint8_t nevents, uint16_t* count, uint32_t* dwell) {
+    unsigned k, n = fsm_trace_len(t);
+    for (k = 0; k < n; ++k) {
+        const struct fsm_record* r = fsm_trace_at(t, k);
+        if (count)
+            ++count[r->state * nevents + r->event];
+        if (dwell && k + 1 < n)
+            dwell[r->next] += fsm_trace_at(t, k + 1)->time - r->time;
+    }
+}
+
+/**
+ * A dispatch function, such as the m_step() generated by fsm_define().
+ */
+typedef uint8_t (*fsm_stepfn)(uint8_t* state, unsigned evt, void* ctx);
+
+/**
+ * Replay a trace through a table-driven machine.
+ *
+ * Replay from a copy of the trace, since stepping a traced machine records
+ * new transitions.
+ * @param t The trace buffer.
+ * @param step The machine's step function.
+ * @param ctx The context passed to the transition actions.
+ * @return The number of records reproduced before the first divergence, or
+ *         fsm_trace_len(t) if the whole trace was reproduced.
+ */
+static unsigned fsm_replay(const fsm_trace* t, fsm_stepfn step, void* ctx) {
+    unsigned k, n = fsm_trace_len(t);
+    uint8_t s = n > 0 ? fsm_trace_at(t, 0)->state : 0;
+    for (k = 0; k < n; ++k) {
+        const struct fsm_record* r = fsm_trace_at(t, k);
+        if (s != r->state || step(&s, r->event, ctx) != r->next)
+            return k;
+    }
+    return n;
+}
+
+/*
+ * Table-driven state machines.
+ *
+ * States, events and transitions are declared as X-macro lists taking the
+ * callback X and the machine name m:
+ *
+ *   #define BLINK_STATES(X, m) X(m, OFF) X(m, ON)
+ *   #define BLINK_EVENTS(X, m) X(m, TICK) X(m, PRESS)
+ *   #define BLINK_TABLE(X, m) \
+ *       X(m, OFF, TICK,  OFF, 0)      \
+ *       X(m, OFF, PRESS, ON,  led_on) \
+ *       X(m, ON,  TICK,  ON,  blink)  \
+ *       X(m, ON,  PRESS, OFF, led_off)
+ *
+ *   fsm_define(blink, BLINK_STATES, BLINK_EVENTS, BLINK_TABLE)
+ *
+ * This declares enums blink_OFF, blink_TICK, etc. and a dense transition
+ * table. Every (state, event) pair must appear exactly once, in state-major
+ * order, or the build fails, so unhandled transitions are caught at compile
+ * time. Dispatch is then a table lookup and at most one call:
+ *
+ *   static uint8_t state = blink_OFF;
+ *   blink_step(&state, blink_PRESS, &ctx);
+ */
+
+/**
+ * A transition action, called with the context passed to the step function.
+ */
+typedef void (*fsm_action)(void* ctx);
+
+/**
+ * An entry in a dense transition table.
+ */
+struct fsm_transition {
+    uint8_t next;
+    fsm_action action;
+};
+
+#define _fsm_enum(m, x) m##_##x,
+#define _fsm_row(m, s, e, n, a) m##_##s##_##e,
+#define _fsm_check(m, s, e, n, a) \
+    typedef char m##_##s##_##e##_out_of_order[((int)m##_##s##_##e == (int)m##_##s * (int)m##_NEVENTS + (int)m##_##e) ? 1 : -1];
+#define _fsm_entry(m, s, e, n, a) { m##_##n, a },
+
+/**
+ * Define a table-driven state machine.
+ *
+ * Generates the m_state and m_event enums, the m_table transition table and
+ * the m_step() dispatch function, plus the m_trace buffer if FSM_TRACE is
+ * defined.
+ * @param m The machine name.
+ * @param STATES The X-macro list of states.
+ * @param EVENTS The X-macro list of events.
+ * @param TABLE The X-macro list of transitions: state, event, next state, action.
+ */
+#define fsm_define(m, STATES, EVENTS, TABLE) \
+    enum m##_state { STATES(_fsm_enum, m) m##_NSTATES }; \
+    enum m##_event { EVENTS(_fsm_enum, m) m##_NEVENTS }; \
+    /* duplicate transitions fail here as duplicate enumerators */ \
+    enum m##_transition { TABLE(_fsm_row, m) m##_NTRANSITIONS }; \
+    /* missing transitions fail here */ \
+    typedef char m##_incomplete_table[((int)m##_NTRANSITIONS == (int)m##_NSTATES * (int)m##_NEVENTS) ? 1 : -1]; \
+    TABLE(_fsm_check, m) \
+    static const struct fsm_transition m##_table[] = { TABLE(_fsm_entry, m) }; \
+    /** \
+     * Dispatch an event. \
+     * @param state The current state, updated to the next state. \
+     * @param evt The event. \
+     * @param ctx The context passed to the transition action. \
+     * @return The next state. \
+     */ \
+    _fsm_trace_decl(m) \
+    static inline uint8_t m##_step(uint8_t* state, unsigned evt, void* ctx) { \
+        const struct fsm_transition* t = &m##_table[*state * (int)m##_NEVENTS + evt]; \
+        _fsm_trace(&m##_trace, *state, evt, t->next); \
+        *state = t->next; \
+        if (t->action) \
+            t->action(ctx); \
+        return *state; \
+    }
+
+/*
+ * Hierarchical state machines.
+ *
+ * States are nested by naming a parent, with ROOT as the implicit outermost
+ * state. Parents must be listed before their children. Each state has
+ * optional entry and exit actions:
+ *
+ *   #define LINK_STATES(X, m)              \
+ *       X(m, IDLE,      ROOT, 0,     0)    \
+ *       X(m, ACTIVE,    ROOT, 0,     drop) \
+ *       X(m, HANDSHAKE, ACTIVE, syn, 0)    \
+ *       X(m, OPEN,      ACTIVE, 0,   0)
+ *   #define LINK_EVENTS(X, m) X(m, CONNECT) X(m, ACK) X(m, DATA) X(m, CLOSE)
+ *   #define LINK_RULES(X, m)                   \
+ *       X(m, IDLE,      CONNECT, HANDSHAKE, 0) \
+ *       X(m, HANDSHAKE, ACK,     OPEN,      0) \
+ *       X(m, HANDSHAKE, DATA,    DEFER,     0) \
+ *       X(m, OPEN,      DATA,    NONE,      rx) \
+ *       X(m, ACTIVE,    CLOSE,   IDLE,      0)
+ *
+ *   hsm_define(link, LINK_STATES, LINK_EVENTS, LINK_RULES)
+ *
+ * An event is handled by the innermost active state with a rule for it. The
+ * target NONE runs the action without changing state, and DEFER holds the
+ * event until the next state change, when it is recalled ahead of newer
+ * events. Events no active state handles are dropped. Events are processed run-to-completion from the machine's equeue:
+ *
+ *   static hsm m;
+ *   hsm_init(&m, &link_def, link_IDLE, &ctx);
+ *   hsm_post(&m, link_CONNECT);   // also from interrupts
+ *   hsm_run(&m);
+ *
+ * The rule index is built at compile time, by designated initializers in C
+ * and constexpr in C++14, along with each rule's exit/entry boundary in
+ * C++14. C computes the boundary per transition, which costs O(depth) like
+ * the exit and entry actions themselves, and C++11 fills both tables in
+ * hsm_init(). Dispatch costs O(depth) with no allocation.
+ */
+
+/**
+ * The implicit outermost state of every hierarchical machine.
+ */
+#define HSM_ROOT 0
+
+/**
+ * A state in a hierarchical machine.
+ */
+struct hsm_state {
+    uint8_t parent;
+    uint8_t depth;
+    fsm_action entry;
+    fsm_action exit;
+};
+
+/**
+ * A rule handling an event in a given state.
+ */
+struct hsm_rule {
+    uint8_t state;
+    uint8_t event;
+    uint8_t target;         /* a state, nstates for NONE, or nstates + 1 for DEFER */
+    fsm_action action;
+};
+
+/**
+ * A hierarchical machine definition, generated by hsm_define().
+ */
+struct hsm_def {
+    const struct hsm_state* states;
+    const struct hsm_rule* rules;
+    const uint8_t* index;   /* rule + 1 per state and event, 0 if unhandled */
+    const uint8_t* lca;     /* per rule, the state at which exits stop and entries start, or NULL */
+    uint8_t nstates;
+    uint8_t nevents;
+    uint8_t nrules;
+};
+
+/**
+ * A running hierarchical machine.
+ */
+typedef struct hsm {
+    const struct hsm_def* def;
+    void* ctx;
+    uint8_t state;
+    equeue evts;
+    equeue deferred;
+#ifdef FSM_TRACE
+    fsm_trace* trace;
+#endif
+} hsm;
+
+#if defined(__cplusplus) && __cplusplus >= 201402L
+#define _hsm_constexpr constexpr
+#else
+#define _hsm_constexpr
+#endif
+
+#if defined(__cplusplus) && __cplusplus < 201402L
+#define _HSM_INIT_TABLES
+#endif
+
+static inline _hsm_constexpr
+uint8_t _hsm_lca(const struct hsm_state* st, uint8_t a, uint8_t b) {
+    while (st[a].depth > st[b].depth)
+        a = st[a].parent;
+    while (st[b].depth > st[a].depth)
+        b = st[b].parent;
+    while (a != b) {
+        a = st[a].parent;
+        b = st[b].parent;
+    }
+    return a;
+}
+
+/* exit up to and enter down from the least common proper ancestor, so self
+ * transitions and transitions to ancestors exit and re-enter */
+static inline _hsm_constexpr
+uint8_t _hsm_rule_lca(const struct hsm_state* st, const struct hsm_rule* r, uint8_t nstates) {
+    return r->target < nstates
+        ? _hsm_lca(st, st[r->state].parent, st[r->target].parent)
+        : r->state;
+}
+
+#define _hsm_state_enum(m, s, p, en, ex) m##_##s,
+#define _hsm_depth(m, s, p, en, ex) m##_##s##_depth = m##_##p##_depth + 1,
+#define _hsm_state(m, s, p, en, ex) { m##_##p, m##_##s##_depth, en, ex },
+#define _hsm_rule(m, s, e, t, a) { m##_##s, m##_##e, m##_##t, a },
+#define _hsm_index(m, s, e, t, a) [(int)m##_##s * (int)m##_NEVENTS + (int)m##_##e] = m##_##s##_##e + 1,
+
+#if defined(__cplusplus) && !defined(_HSM_INIT_TABLES)
+template<unsigned N, unsigned R>
+struct _hsm_tables {
+    uint8_t index[N];
+    uint8_t lca[R];
+};
+
+template<unsigned N, unsigned S, unsigned R>
+constexpr _hsm_tables<N, R> _hsm_build(const hsm_state (&st)[S], const hsm_rule (&rules)[R], unsigned nevents) {
+    _hsm_tables<N, R> t{};
+    for (unsigned i = 0; i < R; ++i) {
+        t.index[rules[i].state * nevents + rules[i].event] = (uint8_t)(i + 1);
+        t.lca[i] = _hsm_rule_lca(st, &rules[i], (uint8_t)S);
+    }
+    return t;
+}
+
+#define _hsm_define_tables(m, STATES, RULES) \
+    static constexpr struct hsm_state m##_states[] = { { m##_ROOT, 0, 0, 0 }, STATES(_hsm_state, m) }; \
+    static constexpr struct hsm_rule m##_rules[] = { RULES(_hsm_rule, m) }; \
+    static constexpr _hsm_tables<(int)m##_NSTATES * (int)m##_NEVENTS, m##_NRULES> m##_tables = \
+        _hsm_build<(int)m##_NSTATES * (int)m##_NEVENTS>(m##_states, m##_rules, m##_NEVENTS);
+#define _hsm_index_table(m) m##_tables.index
+#define _hsm_lca_table(m) m##_tables.lca
+#elif defined(__cplusplus)
+#define _hsm_define_tables(m, STATES, RULES) \
+    static const struct hsm_state m##_states[] = { { m##_ROOT, 0, 0, 0 }, STATES(_hsm_state, m) }; \
+    static const struct hsm_rule m##_rules[] = { RULES(_hsm_rule, m) }; \
+    static uint8_t m##_index[(int)m##_NSTATES * (int)m##_NEVENTS]; \
+    static uint8_t m##_lca[m##_NRULES];
+#define _hsm_index_table(m) m##_index
+#define _hsm_lca_table(m) m##_lca
+#else
+#define _hsm_define_tables(m, STATES, RULES) \
+    static const struct hsm_state m##_states[] = { { m##_ROOT, 0, 0, 0 }, STATES(_hsm_state, m) }; \
+    static const struct hsm_rule m##_rules[] = { RULES(_hsm_rule, m) }; \
+    static const uint8_t m##_index[(int)m##_NSTATES * (int)m##_NEVENTS] = { RULES(_hsm_index, m) };
+#define _hsm_index_table(m) m##_index
+#define _hsm_lca_table(m) 0
+#endif
+
+/**
+ * Define a hierarchical state machine.
+ *
+ * Generates the m_state and m_event enums and the m_def machine definition.
+ * @param m The machine name.
+ * @param STATES The X-macro list of states: state, parent, entry, exit.
+ * @param EVENTS The X-macro list of events.
+ * @param RULES The X-macro list of rules: state, event, target, action.
+ */
+#define hsm_define(m, STATES, EVENTS, RULES) \
+    enum m##_state { m##_ROOT, STATES(_hsm_state_enum, m) m##_NSTATES, m##_NONE = m##_NSTATES, m##_DEFER }; \
+    enum m##_event { EVENTS(_fsm_enum, m) m##_NEVENTS }; \
+    /* a parent listed after its child fails here as an undeclared depth */ \
+    enum m##_depth { m##_ROOT_depth, STATES(_hsm_depth, m) m##_depth_end }; \
+    /* duplicate rules fail here as duplicate enumerators */ \
+    enum m##_rule { RULES(_fsm_row, m) m##_NRULES }; \
+    typedef char m##_too_many_rules[((int)m##_NRULES < 255 && (int)m##_DEFER < 256) ? 1 : -1]; \
+    _hsm_define_tables(m, STATES, RULES) \
+    static const struct hsm_def m##_def = { \
+        m##_states, m##_rules, _hsm_index_table(m), _hsm_lca_table(m), m##_NSTATES, m##_NEVENTS, m##_NRULES \
+    };
+
+static void _hsm_enter(const struct hsm_state* st, uint8_t lca, uint8_t s, void* ctx) {
+    // entry actions run outermost first
+    if (s == lca)
+        return;
+    _hsm_enter(st, lca, st[s].parent, ctx);
+    if (st[s].entry)
+        st[s].entry(ctx);
+}
+
+/**
+ * Initialize a hierarchical machine and enter its initial state.
+ * @param m The machine.
+ * @param def The machine definition, eg. &m_def.
+ * @param initial The initial state.
+ * @param ctx The context passed to all actions.
+ */
+static void hsm_init(hsm* m, const struct hsm_def* def, uint8_t initial, void* ctx) {
+    const struct hsm_state* st = def->states;
+#ifdef _HSM_INIT_TABLES
+    uint8_t* index = (uint8_t*)def->index;
+    uint8_t* lca = (uint8_t*)def->lca;
+    uint8_t i;
+    memset(index, 0, def->nstates * def->nevents);
+    for (i = 0; i < def->nrules; ++i) {
+        index[def->rules[i].state * def->nevents + def->rules[i].event] = i + 1;
+        lca[i] = _hsm_rule_lca(st, &def->rules[i], def->nstates);
+    }
+#endif
+    memset(m, 0, sizeof(*m));
+    m->def = def;
+    m->ctx = ctx;
+    m->state = initial;
+    _hsm_enter(st, HSM_ROOT, initial, ctx);
+}
+
+/**
+ * Post an event to a hierarchical machine.
+ * @param m The machine.
+ * @param e The event.
+ * @return True if the event was queued, false if the queue is full.
+ */
+#define hsm_post(m, e) equeue_add(&(m)->evts, e)
+
+/**
+ * Dispatch a single event to completion.
+ * @param m The machine.
+ * @param e The event.
+ * @return True if the event was handled or deferred, false if it was dropped,
+ *         including when the deferred queue is full.
+ */
+static unsigned hsm_dispatch(hsm* m, uint8_t e) {
+    const struct hsm_def* d = m->def;
+    const struct hsm_state* st = d->states;
+    const struct hsm_rule* r;
+    uint8_t s = m->state, i, lca;
+
+    // find the innermost active state handling the event
+    while (0 == (i = d->index[s * d->nevents + e])) {
+        if (s == HSM_ROOT) {
+#ifdef FSM_TRACE
+            if (m->trace)
+                fsm_trace_add(m->trace, m->state, e, m->state);
+#endif
+            return 0;
+        }
+        s = st[s].parent;
+    }
+    r = &d->rules[i - 1];
+
+#ifdef FSM_TRACE
+    if (m->trace)
+        fsm_trace_add(m->trace, m->state, e, r->target < d->nstates ? r->target : m->state);
+#endif
+    if (r->target > d->nstates) {
+        if (!equeue_add(&m->deferred, e))
+            return 0;
+    } else if (r->target == d->nstates) {
+        if (r->action)
+            r->action(m->ctx);
+    } else {
+        lca = d->lca ? d->lca[i - 1] : _hsm_rule_lca(st, r, d->nstates);
+        for (s = m->state; s != lca; s = st[s].parent) {
+            if (st[s].exit)
+                st[s].exit(m->ctx);
+        }
+        if (r->action)
+            r->action(m->ctx);
+        _hsm_enter(st, lca, r->target, m->ctx);
+        m->state = r->target;
+        // recall deferred events, oldest first, ahead of any newer events;
+        // those that don't fit stay deferred until the next state change
+        while (equeue_size(&m->deferred) > 0) {
+            if (!equeue_push(&m->evts, m->deferred.evts[(uint8_t)(m->deferred.tail - 1) & (EQUEUE_SIZE - 1)]))
+                break;
+            --m->deferred.tail;
+        }
+    }
+    return 1;
+}
+
+/**
+ * Process all queued events, each to completion before the next.
+ * @param m The machine.
+ * @return The number of events processed.
+ */
+static unsigned hsm_run(hsm* m) {
+    unsigned n = 0;
+    uint8_t e;
+    while (equeue_pop(&m->evts, &e)) {
+        hsm_dispatch(m, e);
+        ++n;
+    }
+    return n;
+}
+
+/**
+ * Replay a trace through a hierarchical machine.
+ *
+ * The machine is placed directly in the first record's state without running
+ * entry actions, and events queued as a side effect of each dispatch are
+ * discarded since the trace already records their dispatch.
+ * @param m The initialized machine.
+ * @param t A copy of the trace buffer.
+ * @return The number of records reproduced before the first divergence, or
+ *         fsm_trace_len(t) if the whole trace was reproduced.
+ */
+static unsigned hsm_replay(hsm* m, const fsm_trace* t) {
+    unsigned k, n = fsm_trace_len(t);
+#ifdef FSM_TRACE
+    fsm_trace* saved = m->trace;
+    m->trace = 0;
+#endif
+    if (n > 0)
+        m->state = fsm_trace_at(t, 0)->state;
+    for (k = 0; k < n; ++k) {
+        const struct fsm_record* r = fsm_trace_at(t, k);
+        if (m->state != r->state)
+            break;
+        hsm_dispatch(m, r->event);
+        m->evts.head = m->evts.tail;
+        if (m->state != r->next)
+            break;
+    }
+#ifdef FSM_TRACE
+    m->trace = saved;
+#endif
+    return k;
+}
+
 #endif
\ No newline at end of file
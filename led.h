@@ -43,12 +43,232 @@
  *    // 2 == position of decimal point
  *    led_uint(led, LED_ADDR, x, 2);
  * }
+ *
+ * To skip digits that haven't changed since the last update, keep a
+ * framebuffer per display:
+ *
+ * static led_fb fb;
+ * 
+ * void setup() {
+ *    led_fb_init(&fb);
+ * }
+ * void loop() {
+ *    led_fb_uint(led, LED_ADDR, &fb, x, 2);
+ * }
+ *
+ * Several MAX7219 displays chained on one bus can be refreshed together
+ * through a led_cascade, which sends one frame per digit row covering every
+ * display, so a full refresh takes at most 8 bus transactions:
+ *
+ * static led_cascade leds;
+ * 
+ * static void spi_xfer(void* ctx, const byte* frame, unsigned len) {
+ *    digitalWrite(PIN_CS, LOW);
+ *    for (unsigned i = 0; i < len; ++i) SPI.transfer(frame[i]);
+ *    digitalWrite(PIN_CS, HIGH);
+ * }
+ * void setup() {
+ *    led_cascade_init(&leds, 3, spi_xfer, 0, 20); // 3 displays, at most every 20ms
+ * }
+ * void loop() {
+ *    byte code[8];
+ *    led_fmt_uint(code, x, 2, true);
+ *    led_cascade_digits(&leds, 0, code);
+ *    led_cascade_flush(&leds);
+ * }
  */
 
 //FIXME: should probably move this under arch/arduino/led.h or something
 
 /* depends on LedControl arduino library */
 #include <LedControl.h>
+#include <stdint.h>
+#include "clock.h"
+
+/**
+ * The decimal point bit of a digit code.
+ */
+#define LED_DP 0x80
+
+/**
+ * The code of a digit whose displayed value isn't known.
+ */
+#define LED_UNKNOWN 0xFF
+
+/**
+ * The codes of a blank digit and a minus sign.
+ */
+#define LED_BLANK 0x10
+#define LED_MINUS 0x11
+
+/**
+ * A display framebuffer holding the digit codes last sent to a display.
+ * 
+ * A digit code is the digit value in the low bits, or LED_BLANK or
+ * LED_MINUS, or'd with LED_DP to light the decimal point.
+ */
+typedef struct {
+  byte code[8];
+} led_fb;
+
+/**
+ * Initialize a framebuffer, so the next flush sends every digit.
+ * @param fb The framebuffer
+ */
+static void led_fb_init(led_fb* fb) {
+  for (int digit = 0; digit < 8; ++digit) {
+    fb->code[digit] = LED_UNKNOWN;
+  }
+}
+
+/**
+ * Send a digit code to a display.
+ * @param led   The led module
+ * @param addr  Address of the display
+ * @param digit The digit index
+ * @param code  The digit code
+ */
+static void led_send(LedControl& led, unsigned addr, unsigned digit, byte code) {
+  byte value = code & ~LED_DP;
+  if (value < LED_BLANK) {
+    led.setDigit(addr, digit, value, code & LED_DP);
+  } else {
+    led.setChar(addr, digit, value == LED_MINUS ? '-' : ' ', code & LED_DP);
+  }
+}
+
+/**
+ * Update a display.
+ * Send only the digits whose codes differ from those last sent.
+ * @param led  The led module
+ * @param addr Address of the display
+ * @param fb   The framebuffer of the display
+ * @param code The new digit codes
+ * @return The number of digits sent.
+ */
+static unsigned led_fb_flush(LedControl& led, unsigned addr, led_fb* fb, const byte code[8]) {
+  unsigned sent = 0;
+  for (int digit = 0; digit < 8; ++digit) {
+    if (fb->code[digit] != code[digit]) {
+      led_send(led, addr, digit, code[digit]);
+      fb->code[digit] = code[digit];
+      ++sent;
+    }
+  }
+  return sent;
+}
+
+/**
+ * Divide by 10 with shifts and adds (Hacker's Delight, 10-9).
+ * @param n The dividend
+ * @param r Set to the remainder
+ * @return The quotient
+ */
+static uint32_t led_divu10_shift(uint32_t n, byte* r) {
+  uint32_t q = (n >> 1) + (n >> 2);
+  q += q >> 4;
+  q += q >> 8;
+  q += q >> 16;
+  q >>= 3;
+  n -= ((q << 2) + q) << 1;
+  if (n > 9) {
+    ++q;
+    n -= 10;
+  }
+  *r = (byte)n;
+  return q;
+}
+
+/**
+ * Divide by 10 without a divide instruction.
+ * On AVR this uses led_divu10_shift(), which is far cheaper than the
+ * software division or a 32-bit multiply. Elsewhere the compiler already
+ * turns division by a constant into a reciprocal multiply.
+ * @param n The dividend
+ * @param r Set to the remainder
+ * @return The quotient
+ */
+static uint32_t led_divu10(uint32_t n, byte* r) {
+#ifdef __AVR__
+  return led_divu10_shift(n, r);
+#else
+  uint32_t q = n / 10;
+  *r = (byte)(n - q * 10);
+  return q;
+#endif
+}
+
+/**
+ * Blank the leading zeros of formatted digit codes.
+ * Zeros at or below the decimal point and the lowest digit are kept.
+ * @param code The digit codes
+ */
+static void led_blank(byte code[8]) {
+  for (int digit = 7; digit > 0 && code[digit] == 0; --digit) {
+    code[digit] = LED_BLANK;
+  }
+}
+
+/**
+ * Format an unsigned integer as digit codes.
+ * @param code   The digit codes
+ * @param x      The number to be displayed.
+ * @param period The decimal point index, or 8 or more for none.
+ * @param blank  Blank leading zeros if true.
+ */
+static void led_fmt_uint(byte code[8], unsigned long x, unsigned period, bool blank) {
+  uint32_t n;
+  byte r;
+  /* only the low 8 digits are displayed, so reduce wider values up front */
+  if (x > 0xFFFFFFFFUL) {
+    x %= 100000000UL;
+  }
+  n = (uint32_t)x;
+  for (int digit = 0; digit < 8; ++digit) {
+    n = led_divu10(n, &r);
+    code[digit] = r | ((unsigned)digit == period ? LED_DP : 0);
+  }
+  if (blank) {
+    led_blank(code);
+  }
+}
+
+/**
+ * Format a signed integer as digit codes.
+ * The minus sign goes just above the leading digit when blanking, otherwise
+ * in the highest digit.
+ * @param code   The digit codes
+ * @param x      The number to be displayed.
+ * @param period The decimal point index, or 8 or more for none.
+ * @param blank  Blank leading zeros if true.
+ */
+static void led_fmt_int(byte code[8], long x, unsigned period, bool blank) {
+  led_fmt_uint(code, x < 0 ? 0UL - (unsigned long)x : (unsigned long)x, period, blank);
+  if (x < 0) {
+    int digit = 7;
+    while (digit > 0 && code[digit - 1] == LED_BLANK) {
+      --digit;
+    }
+    code[digit] = LED_MINUS | (code[digit] & LED_DP);
+  }
+}
+
+/**
+ * Format an unsigned integer as hexadecimal digit codes.
+ * @param code   The digit codes
+ * @param x      The number to be displayed.
+ * @param period The decimal point index, or 8 or more for none.
+ * @param blank  Blank leading zeros if true.
+ */
+static void led_fmt_hex(byte code[8], unsigned long x, unsigned period, bool blank) {
+  for (int digit = 0; digit < 8; ++digit) {
+    code[digit] = (byte)(x & 0xF) | ((unsigned)digit == period ? LED_DP : 0);
+    x >>= 4;
+  }
+  if (blank) {
+    led_blank(code);
+  }
+}
 
 /**
  * Display a value.
@@ -58,11 +278,197 @@
  * @param x    The number to be displayed.
  * @param period The decimal point index.
  */
-static void led_uint(LedControl led, unsigned addr, unsigned long x, unsigned period) {
+static void led_uint(LedControl& led, unsigned addr, unsigned long x, unsigned period) {
+  byte code[8];
+  led_fmt_uint(code, x, period, false);
   for (int digit = 0; digit < 8; ++digit) {
-    led.setDigit(addr, digit, (byte)(x % 10), digit == period);
-    x /= 10;
+    led_send(led, addr, digit, code[digit]);
+  }
+}
+
+/**
+ * Display a value through a framebuffer.
+ * Display an unsigned integer on an LED display, sending only the digits
+ * that changed since the last update.
+ * @param led  The led module
+ * @param addr Address of the display
+ * @param fb   The framebuffer of the display
+ * @param x    The number to be displayed.
+ * @param period The decimal point index.
+ * @return The number of digits sent.
+ */
+static unsigned led_fb_uint(LedControl& led, unsigned addr, led_fb* fb, unsigned long x, unsigned period) {
+  byte code[8];
+  led_fmt_uint(code, x, period, false);
+  return led_fb_flush(led, addr, fb, code);
+}
+
+/**
+ * The maximum number of chained displays.
+ */
+#ifndef LED_CASCADE_MAX
+#define LED_CASCADE_MAX 8
+#endif
+
+/**
+ * MAX7219 registers: digit row r is register r + 1.
+ */
+#define LED_REG_NOOP      0x00
+#define LED_REG_DECODE    0x09
+#define LED_REG_INTENSITY 0x0A
+#define LED_REG_SCANLIMIT 0x0B
+#define LED_REG_SHUTDOWN  0x0C
+#define LED_REG_TEST      0x0F
+
+/**
+ * Segment patterns of digit codes 0-F, LED_BLANK and LED_MINUS, in
+ * LedControl's bit order: DP A B C D E F G from the high bit down.
+ */
+static const byte led_segments[18] = {
+  0x7E, 0x30, 0x6D, 0x79, 0x33, 0x5B, 0x5F, 0x70,
+  0x7F, 0x7B, 0x77, 0x1F, 0x0D, 0x3D, 0x4F, 0x47,
+  0x00, 0x01,
+};
+
+/**
+ * Send one frame on a daisy chain, framed by a chip select toggle.
+ * The first bytes sent end up in the last display of the chain.
+ */
+typedef void (*led_xfer)(void* ctx, const byte* frame, unsigned len);
+
+/**
+ * A chain of MAX7219 displays sharing one bus.
+ * 
+ * 'rows' holds the segment patterns to display, and 'dirty' a bit for each
+ * row to resend. Display 0 is the one nearest the bus master.
+ */
+typedef struct {
+  led_xfer xfer;
+  void* ctx;
+  ms_t period;
+  ms_t last;
+  byte ndev;
+  byte dirty;
+  byte bright;
+  byte rows[LED_CASCADE_MAX][8];
+  byte intensity[LED_CASCADE_MAX];
+} led_cascade;
+
+/**
+ * Send a register value to every display in a chain as a single frame.
+ * @param c     The display chain
+ * @param reg   The register
+ * @param value Pointer to the first display's value
+ * @param step  The distance between display values, or 0 for the same value
+ */
+static void led_cascade_send(led_cascade* c, byte reg, const byte* value, unsigned step) {
+  byte frame[2 * LED_CASCADE_MAX];
+  unsigned len = 0;
+  for (int dev = c->ndev - 1; dev >= 0; --dev) {
+    frame[len++] = reg;
+    frame[len++] = value[dev * step];
+  }
+  c->xfer(c->ctx, frame, len);
+}
+
+/**
+ * Initialize a chain of displays.
+ * Wakes every display with decoding off, all digits scanned and every row
+ * marked dirty.
+ * @param c      The display chain
+ * @param ndev   The number of displays, at most LED_CASCADE_MAX
+ * @param xfer   The bus transfer function
+ * @param ctx    The context passed to 'xfer'
+ * @param period The minimum milliseconds between refreshes, or 0 for none
+ */
+static void led_cascade_init(led_cascade* c, byte ndev, led_xfer xfer, void* ctx, ms_t period) {
+  static const byte off = 0, on = 1, all = 7;
+  c->xfer = xfer;
+  c->ctx = ctx;
+  c->ndev = ndev;
+  c->period = period;
+  c->last = clock_ms() - period;
+  c->dirty = 0xFF;
+  c->bright = 0;
+  for (int dev = 0; dev < LED_CASCADE_MAX; ++dev) {
+    c->intensity[dev] = 8;
+    for (int row = 0; row < 8; ++row) {
+      c->rows[dev][row] = 0;
+    }
+  }
+  led_cascade_send(c, LED_REG_TEST, &off, 0);
+  led_cascade_send(c, LED_REG_DECODE, &off, 0);
+  led_cascade_send(c, LED_REG_SCANLIMIT, &all, 0);
+  led_cascade_send(c, LED_REG_INTENSITY, c->intensity, 1);
+  led_cascade_send(c, LED_REG_SHUTDOWN, &on, 0);
+}
+
+/**
+ * Set a row of segments on one display.
+ * @param c       The display chain
+ * @param dev     The display index
+ * @param row     The row, ie. digit, index
+ * @param pattern The segment pattern
+ */
+static void led_cascade_row(led_cascade* c, unsigned dev, unsigned row, byte pattern) {
+  if (c->rows[dev][row] != pattern) {
+    c->rows[dev][row] = pattern;
+    c->dirty |= 1 << row;
+  }
+}
+
+/**
+ * Set the digits of one display.
+ * @param c    The display chain
+ * @param dev  The display index
+ * @param code The digit codes, eg. from led_fmt_uint()
+ */
+static void led_cascade_digits(led_cascade* c, unsigned dev, const byte code[8]) {
+  for (int row = 0; row < 8; ++row) {
+    led_cascade_row(c, dev, row, led_segments[code[row] & ~LED_DP] | (code[row] & LED_DP));
+  }
+}
+
+/**
+ * Set the brightness of one display, sent with the next refresh.
+ * @param c     The display chain
+ * @param dev   The display index
+ * @param level The brightness, 0-15
+ */
+static void led_cascade_intensity(led_cascade* c, unsigned dev, byte level) {
+  if (c->intensity[dev] != level) {
+    c->intensity[dev] = level;
+    c->bright = 1;
+  }
+}
+
+/**
+ * Refresh a chain of displays.
+ * Sends one frame per changed row covering every display, plus one frame
+ * for any brightness change, unless the last refresh was less than the
+ * chain's period ago.
+ * @param c The display chain
+ * @return The number of bus transactions.
+ */
+static unsigned led_cascade_flush(led_cascade* c) {
+  unsigned sent = 0;
+  ms_t now = clock_ms();
+  if ((!c->dirty && !c->bright) || now - c->last < c->period) {
+    return 0;
+  }
+  c->last = now;
+  if (c->bright) {
+    led_cascade_send(c, LED_REG_INTENSITY, c->intensity, 1);
+    c->bright = 0;
+    ++sent;
+  }
+  for (int row = 0; c->dirty; ++row, c->dirty >>= 1) {
+    if (c->dirty & 1) {
+      led_cascade_send(c, row + 1, &c->rows[0][row], 8);
+      ++sent;
+    }
   }
+  return sent;
 }
 
 #endif
\ No newline at end of file
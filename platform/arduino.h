@@ -3,6 +3,7 @@
 #define PLATFORM_H
 
 #define _clock_ms millis
-typedef unsigned long ms_t
+#define _clock_us micros
+typedef unsigned long ms_t;
 
 #endif /* PLATFORM_H */
\ No newline at end of file
@@ -31,7 +31,22 @@
  * THE POSSIBILITY OF SUCH DAMAGE.
  */
 
+#include <stddef.h>
 #include <stdint.h>
+#include "clock.h"
+
+#ifndef ROTARY_NO_SIMD
+#if defined(__AVX2__)
+#define ROTARY_AVX2
+#include <immintrin.h>
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define ROTARY_SSE2
+#include <emmintrin.h>
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+#define ROTARY_NEON
+#include <arm_neon.h>
+#endif
+#endif
 
 /**
  * @file rotary.h
@@ -60,6 +75,17 @@ enum ROTARY_TRANSITIONS {
   ROTARY_CCW = 16770, //=B0100000110000010,
 };
 
+/**
+ * Step deltas indexed by a rotary encoder state: +1 for clockwise, -1 for
+ * counterclockwise, and 0 for no change or an invalid transition.
+ */
+static const int8_t rotary_delta[16] = {
+   0, -1,  1,  0,
+   1,  0,  0, -1,
+  -1,  0,  0,  1,
+   0,  1, -1,  0,
+};
+
 /**
  * @brief Check whether last rotary encoder move was clockwise.
  * 
@@ -85,10 +111,318 @@ enum ROTARY_TRANSITIONS {
  * @return 1 = one step clockwise, -1 = one step counter clockwise, 0 = invalid step
  */
 static int rotary_step(uint16_t *rotary, unsigned rotb, unsigned rota) {
-  *rotary = 0x0f & (*rotary << 2) | rotb << 1 | rota;
-  return rotary_cw(*rotary) ? 1:
-         rotary_ccw(*rotary)?-1:
-                              0;
+  *rotary = (0x0f & (*rotary << 2)) | rotb << 1 | rota;
+  return rotary_delta[*rotary];
+}
+
+/**
+ * Rotary position resolutions: quadrature encoders produce 4 quarter steps
+ * per cycle, and detented encoders typically rest every 2 or 4.
+ */
+#define ROTARY_QUARTER 0
+#define ROTARY_HALF    1
+#define ROTARY_FULL    2
+
+/**
+ * @brief Convert a quarter step count to the given resolution.
+ * 
+ * @param q    Quarter step count
+ * @param mode ROTARY_QUARTER, ROTARY_HALF or ROTARY_FULL
+ * @return The position rounded to the nearest step
+ */
+#define rotary_pos(q, mode) (((q) + ((1 << (mode)) >> 1)) >> (mode))
+
+/**
+ * @brief Process steps of all rotary encoders on a port.
+ * 
+ * Decodes every encoder from a single port snapshot, where encoder i has its
+ * A pin on bit 2i and its B pin on bit 2i+1. Each encoder costs one table
+ * lookup and one add regardless of direction, and nothing is done if no pin
+ * changed. Positions are kept in quarter steps, see rotary_pos(). 'prev' and
+ * 'pos' are volatile so they can be shared with an interrupt handler:
+ * 
+ * static volatile uint16_t rot_port;
+ * static volatile int rot_pos[4];
+ * 
+ * ISR(PCINT2_vect) {
+ *    rotary_port_step(&rot_port, PIND, rot_pos, 4);
+ * }
+ * 
+ * @param prev  The previous port snapshot, updated to 'port'
+ * @param port  The current port snapshot
+ * @param pos   The quarter step positions of the encoders
+ * @param n     The number of encoders on the port, at most 8
+ */
+static void rotary_port_step(volatile uint16_t *prev, uint16_t port, volatile int *pos, unsigned n) {
+  uint16_t last = *prev;
+  unsigned i;
+  if (last == port) {
+    return;
+  }
+  *prev = port;
+  for (i = 0; i < n; ++i, last >>= 2, port >>= 2) {
+    pos[i] += rotary_delta[(last & 0x3) << 2 | (port & 0x3)];
+  }
+}
+
+/**
+ * The EWMA weight of the newest step interval is 1/2^ROTARY_EWMA_SHIFT.
+ */
+#ifndef ROTARY_EWMA_SHIFT
+#define ROTARY_EWMA_SHIFT 2
+#endif
+
+/**
+ * Step intervals are clamped to ROTARY_DT_MAX milliseconds, no greater than 4095.
+ */
+#ifndef ROTARY_DT_MAX
+#define ROTARY_DT_MAX 255
+#endif
+
+/**
+ * An acceleration curve entry: steps arriving on average less than 'ms'
+ * milliseconds apart are multiplied by 'mul'.
+ */
+typedef struct {
+  uint8_t ms;
+  uint8_t mul;
+} rotary_gear;
+
+/**
+ * The default acceleration curve.
+ */
+static const rotary_gear rotary_curve[] = {
+  { 8, 8 }, { 20, 4 }, { 40, 2 },
+};
+
+/**
+ * Rotary encoder velocity tracker.
+ * 
+ * 'ewma' is the average step interval in 1/16 milliseconds.
+ */
+typedef struct {
+  ms_t last;
+  uint16_t ewma;
+  int8_t dir;
+  uint8_t ngears;
+  const rotary_gear *gears;
+} rotary_vel;
+
+/**
+ * @brief Initialize a velocity tracker.
+ * 
+ * @param v      The velocity tracker
+ * @param gears  The acceleration curve, sorted by increasing 'ms'
+ * @param ngears The number of curve entries
+ */
+static void rotary_vel_init(rotary_vel *v, const rotary_gear *gears, uint8_t ngears) {
+  v->last = 0;
+  v->ewma = ROTARY_DT_MAX << 4;
+  v->dir = 0;
+  v->gears = gears;
+  v->ngears = ngears;
+}
+
+/**
+ * @brief Scale a rotary step by the encoder's velocity.
+ * 
+ * Cheap enough to call from the same interrupt as rotary_step(), using only
+ * shifts, adds and a short curve scan. Reversing direction resets the
+ * average, so a fast spin never carries over into fine adjustment.
+ * 
+ * static void rot_onchange() {
+ *    int step = rotary_step(&rot_state, digitalRead(PIN_A), digitalRead(PIN_B));
+ *    rot_pos += rotary_accel(&rot_vel, step, clock_ms());
+ * }
+ * 
+ * @param v     The velocity tracker
+ * @param delta The step, typically from rotary_step()
+ * @param now   The current time in milliseconds
+ * @return The accelerated step
+ */
+static int rotary_accel(rotary_vel *v, int delta, ms_t now) {
+  ms_t dt;
+  uint8_t i;
+  if (delta == 0) {
+    return 0;
+  }
+  dt = now - v->last;
+  v->last = now;
+  if (dt > ROTARY_DT_MAX) {
+    dt = ROTARY_DT_MAX;
+  }
+  if ((delta < 0) != (v->dir < 0)) {
+    v->dir = delta < 0 ? -1 : 1;
+    v->ewma = ROTARY_DT_MAX << 4;
+  }
+  v->ewma = v->ewma - (v->ewma >> ROTARY_EWMA_SHIFT) + (((uint16_t)dt << 4) >> ROTARY_EWMA_SHIFT);
+  for (i = 0; i < v->ngears; ++i) {
+    if (v->ewma < (uint16_t)v->gears[i].ms << 4) {
+      return delta * v->gears[i].mul;
+    }
+  }
+  return delta;
+}
+
+/**
+ * Code block decoding one vector of samples.
+ * 
+ * Expects 'c' to hold the current samples and 'p' the samples before them,
+ * both masked to the A and B bits, and defines 'delta' with each sample's
+ * step and 'bad' with 0xFF lanes for invalid transitions.
+ */
+#define _rotary_vdecode(V, XOR, AND, SRL, SUB, EQ, one, three) \
+  V x = XOR(p, c); \
+  V valid = AND(XOR(x, SRL(x)), one); \
+  V dir = AND(XOR(p, SRL(c)), one); \
+  V delta = SUB(AND(valid, dir), AND(valid, XOR(dir, one))); \
+  V bad = EQ(x, three);
+
+/**
+ * @brief Decode a buffer of captured rotary encoder samples.
+ * 
+ * Each sample byte holds the A pin in bit 0 and the B pin in bit 1, and other
+ * bits are ignored. The positions match calling rotary_step() on each sample
+ * in turn. Uses SSE2, AVX2 or NEON when available, unless ROTARY_NO_SIMD is
+ * defined.
+ * 
+ * @param samples The captured samples
+ * @param n       The number of samples
+ * @param prev    The sample preceding the buffer, updated to the last sample
+ * @param pos     The running position, updated to the final position
+ * @param trace   If not NULL, receives the position after each sample
+ * @return The number of invalid transitions, where both pins changed at once
+ */
+static size_t rotary_decode(const uint8_t *samples, size_t n, uint8_t *prev, int32_t *pos, int32_t *trace) {
+  size_t i = 0, invalid = 0;
+  int32_t at = *pos;
+  uint8_t last = *prev & 0x3;
+  if (n == 0) {
+    return 0;
+  }
+#if defined(ROTARY_AVX2) || defined(ROTARY_SSE2) || defined(ROTARY_NEON)
+  /* decode the first sample alone so every vector can load its predecessors
+   * from the buffer at i - 1 */
+  {
+    uint8_t c = samples[0] & 0x3;
+    at += rotary_delta[last << 2 | c];
+    invalid += (last ^ c) == 0x3;
+    if (trace) {
+      trace[0] = at;
+    }
+    last = c;
+    i = 1;
+  }
+#endif
+#if defined(ROTARY_AVX2)
+  {
+    const __m256i one = _mm256_set1_epi8(1), three = _mm256_set1_epi8(3), zero = _mm256_setzero_si256();
+    const __m256i top = _mm256_set1_epi8(15);
+    __m256i nbad = zero;
+    for (; i + 32 <= n; i += 32) {
+      __m256i c = _mm256_and_si256(_mm256_loadu_si256((const __m256i*)(samples + i)), three);
+      __m256i p = _mm256_and_si256(_mm256_loadu_si256((const __m256i*)(samples + i - 1)), three);
+#define _rotary_srl256(v) _mm256_srli_epi16(v, 1)
+      _rotary_vdecode(__m256i, _mm256_xor_si256, _mm256_and_si256, _rotary_srl256, _mm256_sub_epi8, _mm256_cmpeq_epi8, one, three)
+#undef _rotary_srl256
+      __m256i s = delta;
+      __m128i lo, hi;
+      nbad = _mm256_add_epi64(nbad, _mm256_sad_epu8(_mm256_and_si256(bad, one), zero));
+      /* prefix sum within each 128-bit lane, then carry the low lane's total
+       * into the high lane */
+      s = _mm256_add_epi8(s, _mm256_slli_si256(s, 1));
+      s = _mm256_add_epi8(s, _mm256_slli_si256(s, 2));
+      s = _mm256_add_epi8(s, _mm256_slli_si256(s, 4));
+      s = _mm256_add_epi8(s, _mm256_slli_si256(s, 8));
+      s = _mm256_add_epi8(s, _mm256_permute2x128_si256(_mm256_shuffle_epi8(s, top), s, 0x08));
+      lo = _mm256_castsi256_si128(s);
+      hi = _mm256_extracti128_si256(s, 1);
+      if (trace) {
+        __m256i base = _mm256_set1_epi32(at);
+        _mm256_storeu_si256((__m256i*)(trace + i), _mm256_add_epi32(base, _mm256_cvtepi8_epi32(lo)));
+        _mm256_storeu_si256((__m256i*)(trace + i + 8), _mm256_add_epi32(base, _mm256_cvtepi8_epi32(_mm_srli_si128(lo, 8))));
+        _mm256_storeu_si256((__m256i*)(trace + i + 16), _mm256_add_epi32(base, _mm256_cvtepi8_epi32(hi)));
+        _mm256_storeu_si256((__m256i*)(trace + i + 24), _mm256_add_epi32(base, _mm256_cvtepi8_epi32(_mm_srli_si128(hi, 8))));
+      }
+      at += (int8_t)_mm_extract_epi8(hi, 15);
+    }
+    invalid += (size_t)_mm256_extract_epi64(nbad, 0) + (size_t)_mm256_extract_epi64(nbad, 1)
+             + (size_t)_mm256_extract_epi64(nbad, 2) + (size_t)_mm256_extract_epi64(nbad, 3);
+    last = samples[i - 1] & 0x3;
+  }
+#elif defined(ROTARY_SSE2)
+  {
+    const __m128i one = _mm_set1_epi8(1), three = _mm_set1_epi8(3), zero = _mm_setzero_si128();
+    __m128i nbad = zero;
+    for (; i + 16 <= n; i += 16) {
+      __m128i c = _mm_and_si128(_mm_loadu_si128((const __m128i*)(samples + i)), three);
+      __m128i p = _mm_and_si128(_mm_loadu_si128((const __m128i*)(samples + i - 1)), three);
+#define _rotary_srl128(v) _mm_srli_epi16(v, 1)
+      _rotary_vdecode(__m128i, _mm_xor_si128, _mm_and_si128, _rotary_srl128, _mm_sub_epi8, _mm_cmpeq_epi8, one, three)
+#undef _rotary_srl128
+      __m128i s = delta;
+      nbad = _mm_add_epi64(nbad, _mm_sad_epu8(_mm_and_si128(bad, one), zero));
+      s = _mm_add_epi8(s, _mm_slli_si128(s, 1));
+      s = _mm_add_epi8(s, _mm_slli_si128(s, 2));
+      s = _mm_add_epi8(s, _mm_slli_si128(s, 4));
+      s = _mm_add_epi8(s, _mm_slli_si128(s, 8));
+      if (trace) {
+        /* sign extend bytes to 16 then 32 bits */
+        __m128i base = _mm_set1_epi32(at);
+        __m128i lo = _mm_srai_epi16(_mm_unpacklo_epi8(s, s), 8);
+        __m128i hi = _mm_srai_epi16(_mm_unpackhi_epi8(s, s), 8);
+        _mm_storeu_si128((__m128i*)(trace + i), _mm_add_epi32(base, _mm_srai_epi32(_mm_unpacklo_epi16(lo, lo), 16)));
+        _mm_storeu_si128((__m128i*)(trace + i + 4), _mm_add_epi32(base, _mm_srai_epi32(_mm_unpackhi_epi16(lo, lo), 16)));
+        _mm_storeu_si128((__m128i*)(trace + i + 8), _mm_add_epi32(base, _mm_srai_epi32(_mm_unpacklo_epi16(hi, hi), 16)));
+        _mm_storeu_si128((__m128i*)(trace + i + 12), _mm_add_epi32(base, _mm_srai_epi32(_mm_unpackhi_epi16(hi, hi), 16)));
+      }
+      at += (int8_t)(_mm_extract_epi16(s, 7) >> 8);
+    }
+    invalid += (size_t)_mm_cvtsi128_si32(nbad) + (size_t)_mm_cvtsi128_si32(_mm_srli_si128(nbad, 8));
+    last = samples[i - 1] & 0x3;
+  }
+#elif defined(ROTARY_NEON)
+  {
+    const uint8x16_t one = vdupq_n_u8(1), three = vdupq_n_u8(3);
+    const int8x16_t zero = vdupq_n_s8(0);
+    for (; i + 16 <= n; i += 16) {
+      uint8x16_t c = vandq_u8(vld1q_u8(samples + i), three);
+      uint8x16_t p = vandq_u8(vld1q_u8(samples + i - 1), three);
+#define _rotary_srl8(v) vshrq_n_u8(v, 1)
+      _rotary_vdecode(uint8x16_t, veorq_u8, vandq_u8, _rotary_srl8, vsubq_u8, vceqq_u8, one, three)
+#undef _rotary_srl8
+      int8x16_t s = vreinterpretq_s8_u8(delta);
+      uint64x2_t nbad = vpaddlq_u32(vpaddlq_u16(vpaddlq_u8(vandq_u8(bad, one))));
+      invalid += (size_t)(vgetq_lane_u64(nbad, 0) + vgetq_lane_u64(nbad, 1));
+      s = vaddq_s8(s, vextq_s8(zero, s, 15));
+      s = vaddq_s8(s, vextq_s8(zero, s, 14));
+      s = vaddq_s8(s, vextq_s8(zero, s, 12));
+      s = vaddq_s8(s, vextq_s8(zero, s, 8));
+      if (trace) {
+        int32x4_t base = vdupq_n_s32(at);
+        int16x8_t lo = vmovl_s8(vget_low_s8(s)), hi = vmovl_s8(vget_high_s8(s));
+        vst1q_s32(trace + i, vaddq_s32(base, vmovl_s16(vget_low_s16(lo))));
+        vst1q_s32(trace + i + 4, vaddq_s32(base, vmovl_s16(vget_high_s16(lo))));
+        vst1q_s32(trace + i + 8, vaddq_s32(base, vmovl_s16(vget_low_s16(hi))));
+        vst1q_s32(trace + i + 12, vaddq_s32(base, vmovl_s16(vget_high_s16(hi))));
+      }
+      at += vgetq_lane_s8(s, 15);
+    }
+    last = samples[i - 1] & 0x3;
+  }
+#endif
+  for (; i < n; ++i) {
+    uint8_t c = samples[i] & 0x3;
+    at += rotary_delta[last << 2 | c];
+    invalid += (last ^ c) == 0x3;
+    if (trace) {
+      trace[i] = at;
+    }
+    last = c;
+  }
+  *prev = last;
+  *pos = at;
+  return invalid;
 }
 
 #endif
\ No newline at end of file
@@ -66,7 +66,8 @@
  */
 
 #include <stdlib.h>
-#include <malloc.h>
+#include <stdint.h>
+#include <string.h>
 
 /**
  * The generator status.
@@ -106,7 +107,7 @@ typedef generator (*seq_fn)(seq*, void*);
  * Yield execution.
  * @param x The returned value.
  */
-#define yield(x) { *out=(x); return (generator)__LINE__; case __LINE__: }
+#define yield(x) { *out=(x); return (generator)__LINE__; case __LINE__:; }
 
 /**
  * Exit the current generator.
@@ -135,6 +136,72 @@ typedef generator (*seq_fn)(seq*, void*);
  */
 #define seq_next(f, state, out) (seq_done(state) ? SEQ_DONE : (generator)(((state)->_seq_k=(f)(state, out))))
 
+/**
+ * Mark the start of a batched generator.
+ *
+ * A batched generator fills up to '*n' elements of the caller's buffer per
+ * resume, so the dispatch cost is paid once per batch rather than once per
+ * element. Its parameters must be named 'out' and 'n':
+ *
+ *   generator fn(state* self, T* out, size_t* n)
+ *
+ * @param k The sequence state.
+ */
+#define seq_begin_n(k) size_t _seq_i = 0; seq_begin(k)
+
+/**
+ * Mark the end of a batched generator subroutine.
+ */
+#define seq_end_n *n = _seq_i; seq_end
+
+/**
+ * Exit the current batched generator, keeping the elements already buffered.
+ */
+#define seq_exit_n { *n = _seq_i; return SEQ_DONE; }
+
+/**
+ * Buffer a value, yielding execution once the caller's buffer is full.
+ * @param x The returned value.
+ */
+#define yield_n(x) { out[_seq_i++]=(x); if (_seq_i >= *n) { return (generator)__LINE__; case __LINE__:; } }
+
+/**
+ * Call a batched generator.
+ *
+ * The elements produced are valid even when the generator completes, so
+ * always consume '*n' elements before checking the result.
+ * @param f The batched generator procedure.
+ * @param state The generator procedure state.
+ * @param out The buffer to fill.
+ * @param n On input the buffer capacity (at least 1), on output the number of
+ *          elements filled.
+ * @return The generator state.
+ */
+#define seq_next_n(f, state, out, n) (seq_done(state) ? (*(n)=0, SEQ_DONE) : (generator)(((state)->_seq_k=(f)(state, out, n))))
+
+/**
+ * Fill a buffer from a single-yield generator.
+ *
+ * Compatibility shim giving ordinary generators the seq_next_n() protocol.
+ * @param fn The generator procedure.
+ * @param state The generator state.
+ * @param out The buffer to fill.
+ * @param sz The size of each element.
+ * @param n On input the buffer capacity, on output the number of elements filled.
+ * @return The generator state.
+ */
+static inline
+generator seq_fill(seq_fn fn, seq* state, void* out, size_t sz, size_t* n) {
+    unsigned char* p = (unsigned char*)out;
+    size_t i;
+    for (i = 0; i < *n; ++i, p += sz) {
+        if (seq_next(fn, state, p) == SEQ_DONE)
+            break;
+    }
+    *n = i;
+    return state->_seq_k;
+}
+
 
 // Example:
 typedef struct foo { seq_state; int salary; } * foo_t;
@@ -174,64 +241,641 @@ void dseq_init(seq_fn fn, seq* state, dseq* out) {
  * @param out The next value returned.
  * @return The generator state.
  */
-#define dseq_next(self, out) seq_next(self->fn, self->state, out)
+#define dseq_next(self, out) seq_next((self)->fn, (self)->state, out)
+
+/**
+ * A mapping function.
+ *
+ * Given a pointer to a value, returns a pointer to the mapped value. Maps that
+ * transform the value in place simply return their argument.
+ */
+typedef void* (*seq_mapfn)(void*);
+
+/**
+ * The maximum number of map stages fused into a single map sequence.
+ */
+#ifndef SEQ_MAP_MAX
+#define SEQ_MAP_MAX 8
+#endif
 
 /**
  * The data structure for mapped sequences.
+ *
+ * A map.map.map... sequence is flattened into one ordered list of mapping
+ * stages sharing a single scratch buffer, so each element costs one call per
+ * stage rather than a nested generator call and stack temporary per layer.
  */
 struct seq_map {
+    seq_state;
     dseq seq;
-    size_t sz_tmp;
-    //FIXME: void*->void* is a bit restrictive. This should really be a universal type of some kind:
-    //  typedef union { void *p; unsigned ui; int si; char sc; unsigned char uc; uintptr_t up; ... } univ;
-    void* (*map)(void*);
+    void* tmp;
+    unsigned n;
+    seq_mapfn maps[SEQ_MAP_MAX];
 };
 
+/**
+ * Map the next element in the sequence.
+ * @param self The mapped sequence.
+ * @param out The address of the mapped value, valid until the next call.
+ * @return The generator state.
+ */
+static inline
+generator map_next(struct seq_map* self, void** out) {
+    void* x = self->tmp;
+    unsigned i;
+    generator k = dseq_next(&self->seq, x);
+    if (k != SEQ_DONE) {
+        for (i = 0; i < self->n; ++i)
+            x = self->maps[i](x);
+        *out = x;
+    }
+    return k;
+}
+
 /**
  * Create a dynamic map sequence from a given static sequence.
  * @param fn The function whose values will be mapped.
  * @param state The function state.
  * @param map The mapping function.
- * @param sz_tmp The size of the values returned by 'fn'.
+ * @param tmp The scratch buffer, large enough for the values returned by 'fn'
+ *            and for any value a stage maps in place.
  * @param out The map structure to initialize.
  */
 static inline
-void map_seq(generator (*fn)(void*, void*), seq* state, void* (*map)(void*), size_t sz_tmp, struct seq_map* out) {
-    //FIXME: this copies over seq state, but maybe it should just link to it?
-    //FIXME: optimize a map.map.map... sequence by flattening into an array of mapping functions, ie. something like:
-    //  struct seq_map { dseq seq; size_t n; struct { size_t sz_tmp; void* (*map)(void*) } maps[]; } }
-    //This would eliminate the stack frames and indirect calls of a whole sequence of mapping operations.
-    out->map = map;
-    out->sz_tmp = sz_tmp;
-    dseq_init((seq_fn)&map_next, state, &out->seq);
+void map_seq(generator (*fn)(void*, void*), seq* state, seq_mapfn map, void* tmp, struct seq_map* out) {
+    //FIXME: this links to the seq state, so the source shouldn't be advanced separately
+    dseq_init((seq_fn)fn, state, &out->seq);
+    out->tmp = tmp;
+    out->n = 1;
+    out->maps[0] = map;
+    seq_init(out);
+}
+
+/**
+ * Append a mapping stage to a map sequence.
+ * @param self The map sequence.
+ * @param map The mapping function applied to the output of the last stage.
+ * @return True if the stage was added, false if SEQ_MAP_MAX stages are in use.
+ */
+static inline
+unsigned map_then(struct seq_map* self, seq_mapfn map) {
+    if (self->n >= SEQ_MAP_MAX)
+        return 0;
+    self->maps[self->n++] = map;
+    return 1;
+}
+
+static inline
+void* _map_deref(void* x) {
+    return *(void**)x;
+}
+
+/**
+ * Create a dynamic map sequence from a given map sequence.
+ *
+ * The stages of 'inner' are fused with 'map' instead of nesting, and the
+ * original map sequence should no longer be used. If it already has
+ * SEQ_MAP_MAX stages it is nested instead, and 'tmp' must also be large
+ * enough for a pointer.
+ * @param inner The map sequence to map.
+ * @param map The mapping function.
+ * @param tmp The scratch buffer, as for map_seq.
+ * @param out The map structure to initialize.
+ */
+static inline
+void map_map(struct seq_map* inner, seq_mapfn map, void* tmp, struct seq_map* out) {
+    if (inner->n < SEQ_MAP_MAX) {
+        *out = *inner;
+        out->maps[out->n++] = map;
+    } else {
+        // a full map yields the address of its value, so nest and dereference it
+        dseq_init((seq_fn)&map_next, (seq*)inner, &out->seq);
+        out->n = 2;
+        out->maps[0] = &_map_deref;
+        out->maps[1] = map;
+        seq_init(out);
+    }
+    out->tmp = tmp;
 }
 
 /**
  * Create a dynamic map sequence from a given dynamic sequence.
+ *
+ * A map sequence is recognized by its map_next function and handled as by
+ * map_map. map_next is static, so its address differs between translation
+ * units: a map sequence wrapped in a dseq in another file isn't recognized,
+ * and its elements would be mapped as pointers to its values. Pass such
+ * sequences to map_map instead.
  * @param seq The sequence to map.
  * @param map The mapping function.
- * @param sz_tmp The size of the values returned by 'seq'.
+ * @param tmp The scratch buffer, as for map_seq.
  * @param out The map structure to initialize.
  */
 static inline
-void map_dseq(dseq* seq, void* (*map)(void*), size_t sz_tmp, struct seq_map* out) {
-    out->map = map;
-    out->sz_tmp = sz_tmp;
-    dseq_init(seq->fn, seq->state, &out->seq);
+void map_dseq(dseq* seq, seq_mapfn map, void* tmp, struct seq_map* out) {
+    if (seq->fn == (seq_fn)&map_next) {
+        map_map((struct seq_map*)seq->state, map, tmp, out);
+    } else {
+        dseq_init(seq->fn, seq->state, &out->seq);
+        out->tmp = tmp;
+        out->n = 1;
+        out->maps[0] = map;
+        seq_init(out);
+    }
 }
 
+/**
+ * A register-sized universal value.
+ *
+ * Sequences of scalars yield and map a univ by value, so the elements of a
+ * scalar pipeline stay in registers instead of being staged through memory.
+ * Larger records should keep using seq_map's pointer-based path.
+ */
+typedef union univ {
+    void* p;
+    uintptr_t up;
+    intptr_t ip;
+    unsigned u;
+    int i;
+    unsigned char uc;
+    signed char sc;
+} univ;
+
+/**
+ * The function type for a sequence of universal values.
+ */
+typedef generator (*seq_ufn)(seq*, univ*);
+
+/**
+ * A mapping function over universal values.
+ */
+typedef univ (*seq_umapfn)(univ);
+
+/**
+ * The data structure for mapped sequences of universal values.
+ */
+struct seq_umap {
+    seq_state;
+    dseq seq;
+    unsigned n;
+    seq_umapfn maps[SEQ_MAP_MAX];
+};
+
 /**
  * Map the next element in the sequence.
  * @param self The mapped sequence.
+ * @param out The mapped value.
+ * @return The generator state.
+ */
+static inline
+generator umap_next(struct seq_umap* self, univ* out) {
+    univ x;
+    unsigned i;
+    generator k = dseq_next(&self->seq, &x);
+    if (k != SEQ_DONE) {
+        for (i = 0; i < self->n; ++i)
+            x = self->maps[i](x);
+        *out = x;
+    }
+    return k;
+}
+
+/**
+ * Create a dynamic map sequence from a given static sequence of universal values.
+ * @param fn The function whose values will be mapped.
+ * @param state The function state.
+ * @param map The mapping function.
  * @param out The map structure to initialize.
+ */
+static inline
+void umap_seq(seq_ufn fn, seq* state, seq_umapfn map, struct seq_umap* out) {
+    dseq_init((seq_fn)fn, state, &out->seq);
+    out->n = 1;
+    out->maps[0] = map;
+    seq_init(out);
+}
+
+/**
+ * Append a mapping stage to a map sequence of universal values.
+ * @param self The map sequence.
+ * @param map The mapping function applied to the output of the last stage.
+ * @return True if the stage was added, false if SEQ_MAP_MAX stages are in use.
+ */
+static inline
+unsigned umap_then(struct seq_umap* self, seq_umapfn map) {
+    if (self->n >= SEQ_MAP_MAX)
+        return 0;
+    self->maps[self->n++] = map;
+    return 1;
+}
+
+/**
+ * Create a dynamic map sequence from a given dynamic sequence of universal values.
+ *
+ * As with map_dseq, mapping a umap sequence fuses the stages. A umap
+ * sequence from another translation unit isn't recognized and is nested.
+ * @param seq The sequence to map.
+ * @param map The mapping function.
+ * @param out The map structure to initialize.
+ */
+static inline
+void umap_dseq(dseq* seq, seq_umapfn map, struct seq_umap* out) {
+    struct seq_umap* inner = (struct seq_umap*)seq->state;
+    if (seq->fn == (seq_fn)&umap_next && inner->n < SEQ_MAP_MAX) {
+        *out = *inner;
+        out->maps[out->n++] = map;
+    } else {
+        dseq_init(seq->fn, seq->state, &out->seq);
+        out->n = 1;
+        out->maps[0] = map;
+        seq_init(out);
+    }
+}
+
+/***************** COMBINATORS *****************/
+
+/*
+ * Combinators come in two flavours. The static forms below are loop headers
+ * that call a known generator directly, so the compiler can inline it and
+ * the loop compiles like a hand-written one:
+ *
+ *   int x, sum = 0;
+ *   seq_for_filter(range, &r, x, x % 2 == 0) {
+ *       sum += x;
+ *   }
+ *
+ * The dynamic forms further down wrap a dseq, so pipelines can be composed
+ * at runtime at the cost of one indirect call per stage.
+ */
+
+#define _seq_cat2(x, y) x##y
+#define _seq_cat(x, y) _seq_cat2(x, y)
+#define _seq_var(x) _seq_cat(x, __LINE__)
+
+/**
+ * Loop over every element of a sequence.
+ * @param f The generator procedure.
+ * @param state The generator state.
+ * @param x The variable receiving each element.
+ */
+#define seq_for(f, state, x) while (seq_next(f, state, &(x)))
+
+/**
+ * Loop over the elements satisfying a predicate.
+ * @param f The generator procedure.
+ * @param state The generator state.
+ * @param x The variable receiving each element.
+ * @param pred An expression over 'x' selecting the elements to keep.
+ */
+#define seq_for_filter(f, state, x, pred) seq_for(f, state, x) if (!(pred)) ; else
+
+/**
+ * Loop over at most the first 'n' elements.
+ * @param f The generator procedure.
+ * @param state The generator state.
+ * @param x The variable receiving each element.
+ * @param n The maximum number of elements.
+ */
+#define seq_for_take(f, state, x, n) \
+    for (size_t _seq_var(_seq_take) = (n); _seq_var(_seq_take) && seq_next(f, state, &(x)); --_seq_var(_seq_take))
+
+/**
+ * Loop over the elements after the first 'n'.
+ * @param f The generator procedure.
+ * @param state The generator state.
+ * @param x The variable receiving each element.
+ * @param n The number of elements to skip.
+ */
+#define seq_for_skip(f, state, x, n) \
+    for (size_t _seq_var(_seq_skip) = (n); seq_next(f, state, &(x)); ) if (_seq_var(_seq_skip)) --_seq_var(_seq_skip); else
+
+/**
+ * Loop over two sequences in lockstep, stopping at the end of the shorter.
+ * @param f The first generator procedure.
+ * @param fs The first generator state.
+ * @param x The variable receiving elements of the first sequence.
+ * @param g The second generator procedure.
+ * @param gs The second generator state.
+ * @param y The variable receiving elements of the second sequence.
+ */
+#define seq_for_zip(f, fs, x, g, gs, y) while (seq_next(f, fs, &(x)) && seq_next(g, gs, &(y)))
+
+/**
+ * Loop over each full sliding window of 'n' consecutive elements.
+ *
+ * The window 'w' is an array of at least 'n' elements, oldest first.
+ * @param f The generator procedure.
+ * @param state The generator state.
+ * @param w The window array.
+ * @param n The window length.
+ */
+#define seq_for_window(f, state, w, n) \
+    for (size_t _seq_var(_seq_win) = 0; \
+         (_seq_var(_seq_win) < (n) || (memmove((w), (w) + 1, ((n) - 1) * sizeof(*(w))), 1)) && \
+         seq_next(f, state, &(w)[_seq_var(_seq_win) < (n) ? _seq_var(_seq_win) : (n) - 1]); ) \
+        if (_seq_var(_seq_win) < (n) && ++_seq_var(_seq_win) < (n)) ; else
+
+/**
+ * Fold a sequence into an accumulator.
+ * @param f The generator procedure.
+ * @param state The generator state.
+ * @param x The variable receiving each element.
+ * @param acc The accumulator.
+ * @param expr An expression over 'acc' and 'x' computing the next accumulator.
+ */
+#define seq_fold(f, state, x, acc, expr) seq_for(f, state, x) (acc) = (expr)
+
+/**
+ * A dynamic filtered sequence.
+ */
+struct seq_filter {
+    seq_state;
+    dseq seq;
+    unsigned (*pred)(const void*);
+};
+
+/**
+ * Obtain the next element satisfying the filter.
+ * @param self The filtered sequence.
+ * @param out The next value returned.
+ * @return The generator state.
+ */
+static inline
+generator filter_next(struct seq_filter* self, void* out) {
+    generator k;
+    while ((k = dseq_next(&self->seq, out)) != SEQ_DONE && !self->pred(out))
+        ;
+    return k;
+}
+
+/**
+ * Create a dynamic filtered sequence.
+ * @param seq The sequence to filter.
+ * @param pred The predicate selecting the elements to keep.
+ * @param out The filter structure to initialize.
+ */
+static inline
+void filter_dseq(dseq* seq, unsigned (*pred)(const void*), struct seq_filter* out) {
+    out->seq = *seq;
+    out->pred = pred;
+    seq_init(out);
+}
+
+/**
+ * A dynamic sequence limited to its first elements.
+ */
+struct seq_take {
+    seq_state;
+    dseq seq;
+    size_t n;
+};
+
+/**
+ * Obtain the next element, if any remain.
+ * @param self The take sequence.
+ * @param out The next value returned.
+ * @return The generator state.
+ */
+static inline
+generator take_next(struct seq_take* self, void* out) {
+    if (self->n == 0)
+        return SEQ_DONE;
+    --self->n;
+    return dseq_next(&self->seq, out);
+}
+
+/**
+ * Create a dynamic sequence of at most 'n' elements.
+ * @param seq The source sequence.
+ * @param n The maximum number of elements.
+ * @param out The take structure to initialize.
+ */
+static inline
+void take_dseq(dseq* seq, size_t n, struct seq_take* out) {
+    out->seq = *seq;
+    out->n = n;
+    seq_init(out);
+}
+
+/**
+ * A dynamic sequence without its first elements.
+ */
+struct seq_skip {
+    seq_state;
+    dseq seq;
+    size_t n;
+};
+
+/**
+ * Obtain the next element, skipping any leading elements not yet skipped.
+ * @param self The skip sequence.
+ * @param out The next value returned.
+ * @return The generator state.
+ */
+static inline
+generator skip_next(struct seq_skip* self, void* out) {
+    for (; self->n > 0; --self->n) {
+        if (dseq_next(&self->seq, out) == SEQ_DONE)
+            return SEQ_DONE;
+    }
+    return dseq_next(&self->seq, out);
+}
+
+/**
+ * Create a dynamic sequence skipping the first 'n' elements.
+ * @param seq The source sequence.
+ * @param n The number of elements to skip.
+ * @param out The skip structure to initialize.
+ */
+static inline
+void skip_dseq(dseq* seq, size_t n, struct seq_skip* out) {
+    out->seq = *seq;
+    out->n = n;
+    seq_init(out);
+}
+
+/**
+ * A dynamic sequence pairing the elements of two sequences.
+ */
+struct seq_zip {
+    seq_state;
+    dseq a;
+    dseq b;
+    size_t offset;
+};
+
+/**
+ * Obtain the next pair of elements.
+ * @param self The zipped sequence.
+ * @param out The pair returned, with the element of 'b' at 'offset' bytes.
  * @return The generator state.
  */
 static inline
-generator map_next(struct seq_map* self, void* out) {
-    void* tmp = alloca(self->sz_tmp);
-    generator x = dseq_next((&self->seq), tmp);
-    out = self->map(tmp); // map temporary to final output
-    return x;
+generator zip_next(struct seq_zip* self, void* out) {
+    if (dseq_next(&self->a, out) == SEQ_DONE)
+        return SEQ_DONE;
+    return dseq_next(&self->b, (unsigned char*)out + self->offset);
 }
 
+/**
+ * Create a dynamic sequence of pairs, ending with the shorter sequence.
+ * @param a The sequence of first elements.
+ * @param b The sequence of second elements.
+ * @param offset The offset of the second element in the pair, eg. offsetof(pair, second).
+ * @param out The zip structure to initialize.
+ */
+static inline
+void zip_dseq(dseq* a, dseq* b, size_t offset, struct seq_zip* out) {
+    out->a = *a;
+    out->b = *b;
+    out->offset = offset;
+    seq_init(out);
+}
+
+/**
+ * A dynamic sequence of sliding windows.
+ */
+struct seq_window {
+    seq_state;
+    dseq seq;
+    void* buf;
+    size_t sz;
+    size_t n;
+    size_t len;
+};
+
+/**
+ * Advance the window by one element.
+ * @param self The window sequence.
+ * @param out The address of the window, oldest element first, valid until the next call.
+ * @return The generator state.
+ */
+static inline
+generator window_next(struct seq_window* self, void** out) {
+    unsigned char* w = (unsigned char*)self->buf;
+    generator k;
+    do {
+        if (self->len == self->n) {
+            memmove(w, w + self->sz, (self->n - 1) * self->sz);
+            --self->len;
+        }
+        k = dseq_next(&self->seq, w + self->len * self->sz);
+        if (k == SEQ_DONE)
+            return SEQ_DONE;
+    } while (++self->len < self->n);
+    *out = w;
+    return k;
+}
+
+/**
+ * Create a dynamic sequence of sliding windows of 'n' elements.
+ * @param seq The source sequence.
+ * @param buf The window buffer, holding 'n' elements of size 'sz'.
+ * @param sz The size of each element.
+ * @param n The window length.
+ * @param out The window structure to initialize.
+ */
+static inline
+void window_dseq(dseq* seq, void* buf, size_t sz, size_t n, struct seq_window* out) {
+    out->seq = *seq;
+    out->buf = buf;
+    out->sz = sz;
+    out->n = n;
+    out->len = 0;
+    seq_init(out);
+}
+
+/**
+ * Fold a dynamic sequence into an accumulator.
+ * @param seq The sequence to fold.
+ * @param fold The function combining the accumulator with each element.
+ * @param acc The accumulator.
+ * @param tmp A buffer large enough for one element.
+ */
+static inline
+void fold_dseq(dseq* seq, void (*fold)(void* acc, const void* x), void* acc, void* tmp) {
+    while (dseq_next(seq, tmp))
+        fold(acc, tmp);
+}
+
+/***************** C++ RANGES *****************/
+
+#ifdef __cplusplus
+
+#include <cstddef>
+#include <iterator>
+#if __cplusplus >= 202002L
+#include <ranges>
+#endif
+
+/**
+ * An input range over a static generator.
+ *
+ * The generator is a template argument, so each step is a direct call the
+ * compiler can inline rather than an indirect call through a seq_fn:
+ *
+ *   struct foo f = { SEQ_INIT, 40000 };
+ *   for (int x : seq_range_of(bonus, &f)) { ... }
+ *
+ * The range is single-pass: begin() resumes the generator, and iterating
+ * consumes it. Under C++20 it is a view, so it composes with <ranges>
+ * adaptors such as std::views::filter.
+ */
+template<typename Fn, Fn F>
+class seq_range;
+
+template<typename S, typename T, generator (*F)(S*, T*)>
+class seq_range<generator (*)(S*, T*), F>
+#if __cplusplus >= 202002L
+    : public std::ranges::view_base
+#endif
+{
+    S* state;
+
+public:
+    class iterator {
+        S* state;
+        T x;
+
+        void next() {
+            if (state && !seq_next(F, state, &x))
+                state = 0;
+        }
+
+    public:
+        typedef std::input_iterator_tag iterator_category;
+        typedef T value_type;
+        typedef std::ptrdiff_t difference_type;
+        typedef const T* pointer;
+        typedef const T& reference;
+
+        iterator() : state(0), x() {}
+        explicit iterator(S* state) : state(state), x() { next(); }
+
+        const T& operator*() const { return x; }
+        const T* operator->() const { return &x; }
+        iterator& operator++() { next(); return *this; }
+        void operator++(int) { next(); }
+
+        // all iterators over a finished generator compare equal to end()
+        bool operator==(const iterator& o) const { return state == o.state; }
+        bool operator!=(const iterator& o) const { return state != o.state; }
+    };
+
+    seq_range() : state(0) {}
+    explicit seq_range(S* state) : state(state) {}
+
+    iterator begin() const { return iterator(state); }
+    iterator end() const { return iterator(); }
+};
+
+/**
+ * Create an input range over a static generator.
+ * @param f The generator procedure.
+ * @param state The generator state.
+ */
+#define seq_range_of(f, state) seq_range<decltype(&f), &f>(state)
+
+#endif
+
 #endif  
\ No newline at end of file
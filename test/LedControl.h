@@ -0,0 +1,47 @@
+#pragma once
+#ifndef LEDCONTROL_H
+#define LEDCONTROL_H
+
+/*
+ * A mock of the LedControl Arduino library for host tests, recording the
+ * last value written to each digit and counting bus writes.
+ */
+
+#include <stdint.h>
+
+typedef uint8_t byte;
+
+class LedControl {
+public:
+  enum { DEVICES = 8, BLANK = 0x10, MINUS = 0x11, DP = 0x80 };
+
+  unsigned writes;
+  byte digits[DEVICES][8];
+
+  LedControl() : writes(0) {
+    for (int addr = 0; addr < DEVICES; ++addr)
+      for (int digit = 0; digit < 8; ++digit)
+        digits[addr][digit] = 0;
+  }
+
+  void setDigit(int addr, int digit, byte value, bool dp) {
+    ++writes;
+    digits[addr][digit] = value | (dp ? DP : 0);
+  }
+
+  void setChar(int addr, int digit, char value, bool dp) {
+    ++writes;
+    digits[addr][digit] = (value == '-' ? MINUS : BLANK) | (dp ? DP : 0);
+  }
+
+  void setRow(int addr, int row, byte value) {
+    ++writes;
+    digits[addr][row] = value;
+  }
+
+private:
+  /* the real driver is passed by reference, so copies are a bug */
+  LedControl(const LedControl&);
+};
+
+#endif
@@ -0,0 +1,45 @@
+#pragma once
+#ifndef TEST_BENCH_H
+#define TEST_BENCH_H
+
+/*
+ * Host timing for the benchmarks.
+ */
+
+#include <time.h>
+
+/**
+ * A sink for results, so the compiler can't drop the timed work.
+ */
+static volatile unsigned long bench_sink;
+
+/**
+ * Hide a value from the optimizer, so a hand-written loop can't be folded
+ * into a closed form the generator version couldn't get.
+ */
+#ifdef __GNUC__
+#define bench_opaque(x) __asm__ __volatile__("" : "+r"(x))
+#else
+#define bench_opaque(x) ((void)0)
+#endif
+
+/**
+ * The monotonic time in seconds.
+ */
+static double bench_now(void) {
+  struct timespec t;
+  clock_gettime(CLOCK_MONOTONIC, &t);
+  return t.tv_sec + t.tv_nsec * 1e-9;
+}
+
+/**
+ * A cycle count where the host has a cheap counter, else nanoseconds.
+ */
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#include <x86intrin.h>
+#define bench_cycles() ((unsigned long long)__rdtsc())
+#else
+#define bench_cycles() ((unsigned long long)(bench_now() * 1e9))
+#endif
+
+#endif
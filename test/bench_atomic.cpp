@@ -0,0 +1,128 @@
+#include "host.h"
+#include "atomic.h"
+#include <pthread.h>
+#include <time.h>
+
+/*
+ * Reader throughput of the seqlock, built once per backend:
+ * bench_atomic_fence0 with the volatile backend, bench_atomic_fence1 with
+ * acquire/release fences. Each case is timed alone and against a writer
+ * thread updating the same value. The atomic_cell cases show which
+ * specialization this target picked for each type, and atomic_tbuf the
+ * cost of a wait-free read compared to atomic_readv of the same size.
+ */
+
+#define READS 20000000UL
+
+struct snapshot {
+  uint32_t w[8];
+};
+
+static volatile unsigned version;
+static volatile uint64_t shared64;
+static volatile struct snapshot shared;
+static volatile int writing;
+static volatile unsigned sink;
+
+static double now_s() {
+  struct timespec t;
+  clock_gettime(CLOCK_MONOTONIC, &t);
+  return t.tv_sec + t.tv_nsec * 1e-9;
+}
+
+static void* writer(void*) {
+  struct snapshot s = snapshot();
+  while (writing) {
+    ++s.w[0];
+    atomic_writev(&version, &shared, &s, sizeof(s));
+    atomic_writeu64(&version, &shared64, s.w[0]);
+  }
+  return NULL;
+}
+
+static void read_u64() {
+  for (unsigned long i = 0; i < READS; ++i)
+    sink += (unsigned)atomic_readu64(&version, &shared64);
+}
+
+static void read_v() {
+  for (unsigned long i = 0; i < READS; ++i) {
+    struct snapshot s;
+    atomic_readv(&version, &s, &shared, sizeof(s));
+    sink += s.w[0];
+  }
+}
+
+static atomic_cell<uint32_t> cell32;
+static atomic_cell<uint64_t> cell64;
+static atomic_cell<snapshot> cellv;
+
+static void* cell_writer(void*) {
+  struct snapshot s = snapshot();
+  while (writing) {
+    ++s.w[0];
+    cell32.write(s.w[0]);
+    cell64.write(s.w[0]);
+    cellv.write(s);
+  }
+  return NULL;
+}
+
+static void read_cell32() {
+  for (unsigned long i = 0; i < READS; ++i)
+    sink += cell32.read();
+}
+
+static void read_cell64() {
+  for (unsigned long i = 0; i < READS; ++i)
+    sink += (unsigned)cell64.read();
+}
+
+static void read_cellv() {
+  for (unsigned long i = 0; i < READS; ++i)
+    sink += cellv.read().w[0];
+}
+
+static struct snapshot tbufs[3];
+static atomic_tbuf tb = ATOMIC_TBUF_INIT;
+
+static void* tbuf_writer(void*) {
+  uint32_t seq = 0;
+  while (writing) {
+    tbufs[atomic_tbuf_back(&tb)].w[0] = ++seq;
+    atomic_tbuf_publish(&tb);
+  }
+  return NULL;
+}
+
+/* the reader uses the buffer in place instead of copying it */
+static void read_tbuf() {
+  for (unsigned long i = 0; i < READS; ++i)
+    sink += tbufs[atomic_tbuf_front(&tb)].w[0];
+}
+
+static void run(const char* name, void (*reads)(), void* (*write)(void*) = writer) {
+  double start = now_s();
+  reads();
+  double alone = now_s() - start;
+  pthread_t w;
+  writing = 1;
+  pthread_create(&w, NULL, write, NULL);
+  start = now_s();
+  reads();
+  double contended = now_s() - start;
+  writing = 0;
+  pthread_join(w, NULL);
+  printf("ATOMIC_FENCE=%d %-18s %7.1f Mreads/s alone %7.1f Mreads/s with writer\n",
+         ATOMIC_FENCE, name, READS / alone * 1e-6, READS / contended * 1e-6);
+}
+
+int main() {
+  run("atomic_readu64", read_u64);
+  run("atomic_readv 32B", read_v);
+  run(_atomic_native<uint32_t>::value ? "cell<u32> native" : "cell<u32> version", read_cell32, cell_writer);
+  run(_atomic_native<uint64_t>::value ? "cell<u64> native" : "cell<u64> version", read_cell64, cell_writer);
+  run("cell<32B> version", read_cellv, cell_writer);
+  run("atomic_tbuf 32B", read_tbuf, tbuf_writer);
+  return 0;
+}
@@ -0,0 +1,63 @@
+#include "host.h"
+#include "bench.h"
+#include "btn.h"
+
+/*
+ * Debounce 32 inputs per sample with one btn_bank32_poll() against 32
+ * btn_poll() calls, over the same pseudo-random noisy input.
+ */
+
+#define SAMPLES 4096
+#define ROUNDS 2000
+
+static uint32_t input[SAMPLES];
+
+static double run_bank(void) {
+    btn_bank32 bank = { 0, 0, 0 };
+    uint32_t changed = 0;
+    double start = bench_now();
+    unsigned r, i;
+    for (r = 0; r < ROUNDS; ++r)
+        for (i = 0; i < SAMPLES; ++i) {
+            uint32_t sample = input[i];
+            bench_opaque(sample);
+            changed ^= btn_bank32_poll(&bank, sample);
+        }
+    bench_sink = bench_sink + changed + bank.state;
+    return bench_now() - start;
+}
+
+static double run_single(void) {
+    btn_sync btn[32] = { { 0, 0 } };
+    unsigned changed = 0;
+    double start = bench_now();
+    unsigned r, i, b;
+    for (r = 0; r < ROUNDS; ++r)
+        for (i = 0; i < SAMPLES; ++i) {
+            uint32_t sample = input[i];
+            bench_opaque(sample);
+            for (b = 0; b < 32; ++b)
+                changed += btn_poll((sample >> b) & 1, &btn[b], 3);
+        }
+    bench_sink = bench_sink + changed;
+    return bench_now() - start;
+}
+
+int main(void) {
+    uint32_t x = 1, level = 0;
+    double bank, single;
+    unsigned i;
+    for (i = 0; i < SAMPLES; ++i) {
+        x ^= x << 13;
+        x ^= x >> 17;
+        x ^= x << 5;
+        if (i % 16 == 0)
+            level ^= x & (x >> 7);
+        input[i] = level ^ (x & (x >> 3) & (x >> 11));
+    }
+    bank = run_bank();
+    single = run_single();
+    printf("btn_bank32_poll: %6.2f ns/sample\n", bank * 1e9 / ((double)ROUNDS * SAMPLES));
+    printf("32 x btn_poll:   %6.2f ns/sample (%.1fx)\n", single * 1e9 / ((double)ROUNDS * SAMPLES), single / bank);
+    return 0;
+}
@@ -0,0 +1,53 @@
+#include "host.h"
+#include "bench.h"
+#include "fsm_door.h"
+
+/*
+ * Dispatch speed of a fsm_define() machine against the same machine as a
+ * switch, over a fixed pseudo-random event stream. 'make bench' also lists
+ * the code and table sizes of the two dispatchers from the symbol table.
+ */
+
+#define EVENTS 4096
+#define ROUNDS 5000
+
+/* out of line, so the symbol sizes measure each dispatcher */
+#ifdef __GNUC__
+#define BENCH_NOINLINE __attribute__((noinline))
+#else
+#define BENCH_NOINLINE
+#endif
+
+BENCH_NOINLINE uint8_t bench_table_step(uint8_t* state, unsigned evt, void* ctx) {
+    return door_step(state, evt, ctx);
+}
+
+BENCH_NOINLINE uint8_t bench_switch_step(uint8_t* state, unsigned evt, void* ctx) {
+    return door_switch_step(state, evt, ctx);
+}
+
+static double run(uint8_t (*step)(uint8_t*, unsigned, void*), const uint8_t* events) {
+    struct door d = { 0, 0, 0 };
+    uint8_t s = door_CLOSED;
+    double start = bench_now();
+    unsigned r, i;
+    for (r = 0; r < ROUNDS; ++r)
+        for (i = 0; i < EVENTS; ++i)
+            step(&s, events[i], &d);
+    bench_sink = bench_sink + d.opens + d.closes + d.locks + s;
+    return bench_now() - start;
+}
+
+int main(void) {
+    static uint8_t events[EVENTS];
+    uint32_t x = 12345;
+    double n = (double)EVENTS * ROUNDS;
+    unsigned i;
+    for (i = 0; i < EVENTS; ++i) {
+        x = x * 1103515245u + 12345u;
+        events[i] = (uint8_t)((x >> 16) % door_NEVENTS);
+    }
+    printf("fsm_define table: %6.1f M events/s\n", n / run(bench_table_step, events) * 1e-6);
+    printf("switch:           %6.1f M events/s\n", n / run(bench_switch_step, events) * 1e-6);
+    return 0;
+}
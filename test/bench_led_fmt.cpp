@@ -0,0 +1,44 @@
+#include "host.h"
+#include "led.h"
+#include <time.h>
+
+/*
+ * Host timing of the digit formatters against the modulo loop they replace.
+ * Host compilers already divide by 10 with a multiply, so this mainly guards
+ * against regressions; the shift-add divide only pays off on AVR.
+ */
+
+static volatile unsigned sink;
+
+static void naive_uint(byte code[8], unsigned long x, unsigned period) {
+  for (int digit = 0; digit < 8; ++digit) {
+    code[digit] = (byte)(x % 10) | ((unsigned)digit == period ? LED_DP : 0);
+    x /= 10;
+  }
+}
+
+#define BENCH(name, expr) { \
+    byte code[8]; \
+    clock_t start = clock(); \
+    for (unsigned long x = 0; x < N; ++x) { \
+      expr; \
+      sink += code[3]; \
+    } \
+    printf("%-20s %6.1f ns/call\n", name, 1e9 * (clock() - start) / CLOCKS_PER_SEC / N); \
+  }
+
+int main() {
+  const unsigned long N = 20000000UL;
+  BENCH("naive modulo", naive_uint(code, x * 97, 8))
+  BENCH("led_fmt_uint", led_fmt_uint(code, x * 97, 8, false))
+  BENCH("led_fmt_uint blank", led_fmt_uint(code, x * 97, 8, true))
+  BENCH("led_fmt_hex", led_fmt_hex(code, x * 97, 8, false))
+  {
+    byte r;
+    clock_t start = clock();
+    for (unsigned long x = 0; x < N; ++x)
+      sink += led_divu10_shift((uint32_t)(x * 97), &r) + r;
+    printf("%-20s %6.1f ns/call\n", "led_divu10_shift", 1e9 * (clock() - start) / CLOCKS_PER_SEC / N);
+  }
+  return 0;
+}
@@ -0,0 +1,80 @@
+#include "host.h"
+#include "bench.h"
+#include "rotary.h"
+
+/*
+ * Samples per second decoded by rotary_decode() against a rotary_step()
+ * loop, for short buffers around the vector widths and a long capture,
+ * with and without a position trace.
+ */
+
+#define TOTAL (1UL << 25)
+#define MAXN 4096
+
+static uint8_t samples[MAXN];
+static int32_t trace[MAXN];
+
+static double run_decode(size_t n, int32_t* tr) {
+  uint8_t prev = 0;
+  int32_t pos = 0;
+  size_t invalid = 0;
+  unsigned long r, rounds = TOTAL / n;
+  double start = bench_now();
+  for (r = 0; r < rounds; ++r) {
+    const uint8_t* s = samples;
+    bench_opaque(s);
+    invalid += rotary_decode(s, n, &prev, &pos, tr);
+  }
+  bench_sink = bench_sink + invalid + pos + (tr ? tr[n - 1] : 0);
+  return (double)rounds * n / (bench_now() - start);
+}
+
+static double run_step(size_t n, int32_t* tr) {
+  uint16_t state = 0;
+  int32_t pos = 0;
+  unsigned long r, rounds = TOTAL / n;
+  size_t i;
+  double start = bench_now();
+  for (r = 0; r < rounds; ++r) {
+    const uint8_t* s = samples;
+    bench_opaque(s);
+    for (i = 0; i < n; ++i) {
+      pos += rotary_step(&state, (s[i] >> 1) & 1, s[i] & 1);
+      if (tr)
+        tr[i] = pos;
+    }
+  }
+  bench_sink = bench_sink + pos + (tr ? tr[n - 1] : 0);
+  return (double)rounds * n / (bench_now() - start);
+}
+
+int main(void) {
+  static const size_t lengths[] = { 16, 17, 32, 33, MAXN };
+  static const uint8_t gray[4] = { 0, 1, 3, 2 };
+  uint32_t x = 1;
+  unsigned at = 0, i;
+  const char* simd =
+#if defined(ROTARY_AVX2)
+    "AVX2";
+#elif defined(ROTARY_SSE2)
+    "SSE2";
+#elif defined(ROTARY_NEON)
+    "NEON";
+#else
+    "scalar";
+#endif
+  for (i = 0; i < MAXN; ++i) {
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    at += (x & 3) == 0 ? 3 : (x & 4) ? 1 : 0;
+    samples[i] = gray[at & 3];
+  }
+  for (i = 0; i < sizeof(lengths) / sizeof(lengths[0]); ++i) {
+    size_t n = lengths[i];
+    printf("rotary_decode %-6s n=%-4u: %7.1f M samples/s, %7.1f traced; rotary_step %7.1f, %7.1f traced\n",
+           simd, (unsigned)n, run_decode(n, NULL) * 1e-6, run_decode(n, trace) * 1e-6,
+           run_step(n, NULL) * 1e-6, run_step(n, trace) * 1e-6);
+  }
+  return 0;
+}
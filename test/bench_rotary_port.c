@@ -0,0 +1,64 @@
+#include "host.h"
+#include "bench.h"
+#include "rotary.h"
+
+/*
+ * Cycles per port snapshot to decode 4 and 8 encoders with one
+ * rotary_port_step() against a rotary_step() call per encoder, as each
+ * would be handled in a pin change interrupt.
+ */
+
+#define SAMPLES 4096
+#define ROUNDS 2000
+
+static uint16_t input[SAMPLES];
+
+static double run_port(unsigned n) {
+    uint16_t prev = 0;
+    int pos[8] = { 0 };
+    unsigned long long start = bench_cycles();
+    unsigned r, i;
+    for (r = 0; r < ROUNDS; ++r)
+        for (i = 0; i < SAMPLES; ++i) {
+            uint16_t pins = input[i];
+            bench_opaque(pins);
+            rotary_port_step(&prev, pins, pos, n);
+        }
+    bench_sink = bench_sink + pos[0] + pos[n - 1];
+    return (double)(bench_cycles() - start) / ((double)ROUNDS * SAMPLES);
+}
+
+static double run_single(unsigned n) {
+    uint16_t state[8] = { 0 };
+    int pos[8] = { 0 };
+    unsigned long long start = bench_cycles();
+    unsigned r, i, e;
+    for (r = 0; r < ROUNDS; ++r)
+        for (i = 0; i < SAMPLES; ++i) {
+            uint16_t pins = input[i];
+            bench_opaque(pins);
+            for (e = 0; e < n; ++e)
+                pos[e] += rotary_step(&state[e], (pins >> (2 * e + 1)) & 1, (pins >> (2 * e)) & 1);
+        }
+    bench_sink = bench_sink + pos[0] + pos[n - 1];
+    return (double)(bench_cycles() - start) / ((double)ROUNDS * SAMPLES);
+}
+
+int main(void) {
+    uint32_t x = 1;
+    uint16_t pins = 0;
+    unsigned i, n;
+    /* one pin changes per interrupt, as with turning encoders */
+    for (i = 0; i < SAMPLES; ++i) {
+        x ^= x << 13;
+        x ^= x >> 17;
+        x ^= x << 5;
+        pins ^= (uint16_t)(1u << (x % 16));
+        input[i] = pins;
+    }
+    for (n = 4; n <= 8; n += 4) {
+        double port = run_port(n), single = run_single(n);
+        printf("%u encoders: rotary_port_step %5.1f, rotary_step %5.1f cycles/snapshot\n", n, port, single);
+    }
+    return 0;
+}
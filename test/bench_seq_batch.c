@@ -0,0 +1,55 @@
+#include "host.h"
+#include "bench.h"
+#include "seq_count.h"
+
+/*
+ * Elements per second pulled one at a time with seq_next, in batches with
+ * seq_next_n, and through the seq_fill shim, each through a function
+ * pointer as a dynamic sequence would be.
+ */
+
+#define ELEMENTS 20000000
+#define BATCH 64
+
+static generator (*volatile next)(struct count*, int*) = count;
+static generator (*volatile next_n)(struct count*, int*, size_t*) = count_n;
+
+int main(void) {
+  struct count src;
+  int buf[BATCH], x;
+  unsigned long sum = 0;
+  double start, one, batched, fill;
+  size_t n, i;
+
+  count_init(&src, ELEMENTS);
+  start = bench_now();
+  while (seq_next(next, &src, &x))
+    sum += x;
+  one = bench_now() - start;
+
+  count_init(&src, ELEMENTS);
+  start = bench_now();
+  do {
+    n = BATCH;
+    seq_next_n(next_n, &src, buf, &n);
+    for (i = 0; i < n; ++i)
+      sum += buf[i];
+  } while (n);
+  batched = bench_now() - start;
+
+  count_init(&src, ELEMENTS);
+  start = bench_now();
+  do {
+    n = BATCH;
+    seq_fill((seq_fn)next, (seq*)&src, buf, sizeof(int), &n);
+    for (i = 0; i < n; ++i)
+      sum += buf[i];
+  } while (n);
+  fill = bench_now() - start;
+
+  bench_sink = bench_sink + sum;
+  printf("seq_next:        %6.1f M/s\n", ELEMENTS / one * 1e-6);
+  printf("seq_next_n(%d):  %6.1f M/s, %.1fx\n", BATCH, ELEMENTS / batched * 1e-6, one / batched);
+  printf("seq_fill(%d):    %6.1f M/s, %.1fx\n", BATCH, ELEMENTS / fill * 1e-6, one / fill);
+  return 0;
+}
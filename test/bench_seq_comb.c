@@ -0,0 +1,112 @@
+#include "host.h"
+#include "bench.h"
+#include "seq_count.h"
+
+/*
+ * Elements per second through the static combinators, against the same
+ * loop written by hand and against the dynamic combinators.
+ */
+
+#define ELEMENTS 20000000
+
+static unsigned even(const void* x) {
+  return *(const int*)x % 2 == 0;
+}
+
+static void report(const char* name, double t, double hand) {
+  printf("%-24s %6.1f M/s, %.2fx the hand-written loop\n", name, ELEMENTS / t * 1e-6, hand / t);
+}
+
+int main(void) {
+  struct count src;
+  unsigned long sum = 0;
+  double start, hand, t;
+  int x, i;
+
+  /* sum of the even elements */
+  start = bench_now();
+  for (i = 1; i <= ELEMENTS; ++i) {
+    bench_opaque(i);
+    if (i % 2 == 0)
+      sum += i;
+  }
+  hand = bench_now() - start;
+  printf("%-24s %6.1f M/s\n", "hand filter", ELEMENTS / hand * 1e-6);
+
+  count_init(&src, ELEMENTS);
+  start = bench_now();
+  seq_for_filter(count, &src, x, x % 2 == 0) {
+    sum += x;
+  }
+  report("seq_for_filter", bench_now() - start, hand);
+
+  {
+    struct seq_filter f;
+    dseq d;
+    count_init(&src, ELEMENTS);
+    dseq_init((seq_fn)count, (seq*)&src, &d);
+    filter_dseq(&d, even, &f);
+    start = bench_now();
+    while (seq_next(filter_next, &f, &x))
+      sum += x;
+    report("filter_dseq", bench_now() - start, hand);
+  }
+
+  /* sum of each window of 4 */
+  {
+    int w[4], a = 0, b = 0, c = 0;
+    start = bench_now();
+    for (i = 1; i <= ELEMENTS; ++i) {
+      bench_opaque(i);
+      if (i >= 4)
+        sum += a + b + c + i;
+      a = b;
+      b = c;
+      c = i;
+    }
+    hand = bench_now() - start;
+    printf("%-24s %6.1f M/s\n", "hand window", ELEMENTS / hand * 1e-6);
+
+    count_init(&src, ELEMENTS);
+    start = bench_now();
+    seq_for_window(count, &src, w, 4) {
+      sum += w[0] + w[1] + w[2] + w[3];
+    }
+    t = bench_now() - start;
+    report("seq_for_window", t, hand);
+  }
+
+  /* skip the first half of the elements */
+  start = bench_now();
+  for (i = 1; i <= ELEMENTS; ++i) {
+    bench_opaque(i);
+    if (i > ELEMENTS / 2)
+      sum += i;
+  }
+  hand = bench_now() - start;
+  printf("%-24s %6.1f M/s\n", "hand skip", ELEMENTS / hand * 1e-6);
+  count_init(&src, ELEMENTS);
+  start = bench_now();
+  seq_for_skip(count, &src, x, ELEMENTS / 2) {
+    sum += x;
+  }
+  report("seq_for_skip", bench_now() - start, hand);
+
+  /* take all the elements, counting down the limit */
+  start = bench_now();
+  for (i = 1; i <= ELEMENTS; ++i) {
+    bench_opaque(i);
+    sum += i;
+  }
+  hand = bench_now() - start;
+  printf("%-24s %6.1f M/s\n", "hand take", ELEMENTS / hand * 1e-6);
+  count_init(&src, ELEMENTS);
+  start = bench_now();
+  seq_for_take(count, &src, x, ELEMENTS) {
+    sum += x;
+  }
+  report("seq_for_take", bench_now() - start, hand);
+
+  bench_sink = bench_sink + sum;
+  return 0;
+}
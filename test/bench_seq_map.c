@@ -0,0 +1,54 @@
+#include "host.h"
+#include "bench.h"
+#include "seq_count.h"
+
+/*
+ * Elements per second through fused map chains of each depth, against the
+ * same stages called directly in a loop.
+ */
+
+#define ELEMENTS 10000000
+
+static void* add1(void* x) {
+  *(int*)x += 1;
+  return x;
+}
+
+/* called through a pointer, as the fused stages are */
+static void* (*volatile stage)(void*) = add1;
+
+int main(void) {
+  int depth;
+  for (depth = 1; depth <= SEQ_MAP_MAX; ++depth) {
+    struct count src;
+    struct seq_map maps[SEQ_MAP_MAX];
+    int tmp[2], d, i;
+    void* x;
+    double start, fused, direct;
+    unsigned long sum = 0;
+    count_init(&src, ELEMENTS);
+    map_seq((generator (*)(void*, void*))count, (seq*)&src, add1, tmp, &maps[0]);
+    for (d = 1; d < depth; ++d) {
+      dseq inner;
+      dseq_init((seq_fn)map_next, (seq*)&maps[d - 1], &inner);
+      map_dseq(&inner, add1, tmp, &maps[d]);
+    }
+    start = bench_now();
+    while (seq_next(map_next, &maps[depth - 1], &x))
+      sum += *(int*)x;
+    fused = bench_now() - start;
+
+    start = bench_now();
+    for (i = 1; i <= ELEMENTS; ++i) {
+      int v = i;
+      for (d = 0; d < depth; ++d)
+        stage(&v);
+      sum += v;
+    }
+    direct = bench_now() - start;
+    bench_sink = bench_sink + sum;
+    printf("map depth %d: %6.1f M/s fused, %6.1f M/s direct\n",
+           depth, ELEMENTS / fused * 1e-6, ELEMENTS / direct * 1e-6);
+  }
+  return 0;
+}
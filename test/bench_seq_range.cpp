@@ -0,0 +1,63 @@
+#include "host.h"
+#include "bench.h"
+#include "seq_count.h"
+
+/*
+ * The overhead of iterating a generator as a range, against seq_next and a
+ * hand-written loop, with and without a C++20 views pipeline.
+ */
+
+#define ELEMENTS 20000000
+
+static void report(const char* name, double t, double hand) {
+  printf("%-22s %6.1f M/s, %.2fx the hand-written loop\n", name, ELEMENTS / t * 1e-6, hand / t);
+}
+
+int main() {
+  struct count src;
+  unsigned long sum = 0;
+  double start, hand;
+  int x;
+
+  start = bench_now();
+  for (int i = 1; i <= ELEMENTS; ++i) {
+    bench_opaque(i);
+    sum += i;
+  }
+  hand = bench_now() - start;
+  printf("%-22s %6.1f M/s\n", "hand loop", ELEMENTS / hand * 1e-6);
+
+  count_init(&src, ELEMENTS);
+  start = bench_now();
+  while (seq_next(count, &src, &x))
+    sum += x;
+  report("seq_next", bench_now() - start, hand);
+
+  count_init(&src, ELEMENTS);
+  start = bench_now();
+  for (int x : seq_range_of(count, &src))
+    sum += x;
+  report("seq_range", bench_now() - start, hand);
+
+#if __cplusplus >= 202002L
+  start = bench_now();
+  for (int i = 1; i <= ELEMENTS; ++i) {
+    bench_opaque(i);
+    if (i % 3)
+      sum += i * 2;
+  }
+  hand = bench_now() - start;
+  printf("%-22s %6.1f M/s\n", "hand filter/transform", ELEMENTS / hand * 1e-6);
+
+  count_init(&src, ELEMENTS);
+  start = bench_now();
+  for (int x : seq_range_of(count, &src)
+           | std::views::filter([](int x) { return x % 3; })
+           | std::views::transform([](int x) { return x * 2; }))
+    sum += x;
+  report("seq_range | views", bench_now() - start, hand);
+#endif
+
+  bench_sink = bench_sink + sum;
+  return 0;
+}
@@ -0,0 +1,80 @@
+#pragma once
+#ifndef TEST_FSM_DOOR_H
+#define TEST_FSM_DOOR_H
+
+/*
+ * A door controller, shared by the fsm.h tests and benchmarks: it opens on a
+ * button press, closes after a timeout, reopens if blocked while closing, and
+ * a key locks and unlocks it while closed.
+ */
+
+#include "fsm.h"
+
+struct door {
+    unsigned opens;
+    unsigned closes;
+    unsigned locks;
+};
+
+static void door_open(void* c) { ++((struct door*)c)->opens; }
+static void door_close(void* c) { ++((struct door*)c)->closes; }
+static void door_lock(void* c) { ++((struct door*)c)->locks; }
+
+#define DOOR_STATES(X, m) X(m, CLOSED) X(m, OPENING) X(m, OPEN) X(m, CLOSING) X(m, LOCKED)
+#define DOOR_EVENTS(X, m) X(m, PRESS) X(m, DONE) X(m, TIMEOUT) X(m, BLOCKED) X(m, KEY)
+#define DOOR_TABLE(X, m)                               \
+    X(m, CLOSED,  PRESS,   OPENING, door_open)         \
+    X(m, CLOSED,  DONE,    CLOSED,  0)                 \
+    X(m, CLOSED,  TIMEOUT, CLOSED,  0)                 \
+    X(m, CLOSED,  BLOCKED, CLOSED,  0)                 \
+    X(m, CLOSED,  KEY,     LOCKED,  door_lock)         \
+    X(m, OPENING, PRESS,   OPENING, 0)                 \
+    X(m, OPENING, DONE,    OPEN,    0)                 \
+    X(m, OPENING, TIMEOUT, OPENING, 0)                 \
+    X(m, OPENING, BLOCKED, OPENING, 0)                 \
+    X(m, OPENING, KEY,     OPENING, 0)                 \
+    X(m, OPEN,    PRESS,   OPEN,    0)                 \
+    X(m, OPEN,    DONE,    OPEN,    0)                 \
+    X(m, OPEN,    TIMEOUT, CLOSING, door_close)        \
+    X(m, OPEN,    BLOCKED, OPEN,    0)                 \
+    X(m, OPEN,    KEY,     OPEN,    0)                 \
+    X(m, CLOSING, PRESS,   OPENING, door_open)         \
+    X(m, CLOSING, DONE,    CLOSED,  0)                 \
+    X(m, CLOSING, TIMEOUT, CLOSING, 0)                 \
+    X(m, CLOSING, BLOCKED, OPENING, door_open)         \
+    X(m, CLOSING, KEY,     CLOSING, 0)                 \
+    X(m, LOCKED,  PRESS,   LOCKED,  0)                 \
+    X(m, LOCKED,  DONE,    LOCKED,  0)                 \
+    X(m, LOCKED,  TIMEOUT, LOCKED,  0)                 \
+    X(m, LOCKED,  BLOCKED, LOCKED,  0)                 \
+    X(m, LOCKED,  KEY,     CLOSED,  door_lock)
+
+fsm_define(door, DOOR_STATES, DOOR_EVENTS, DOOR_TABLE)
+
+/**
+ * The same machine as a hand-written switch.
+ */
+static uint8_t door_switch_step(uint8_t* state, unsigned evt, void* ctx) {
+    switch (*state) {
+    case door_CLOSED:
+        if (evt == door_PRESS) { *state = door_OPENING; door_open(ctx); }
+        else if (evt == door_KEY) { *state = door_LOCKED; door_lock(ctx); }
+        break;
+    case door_OPENING:
+        if (evt == door_DONE) *state = door_OPEN;
+        break;
+    case door_OPEN:
+        if (evt == door_TIMEOUT) { *state = door_CLOSING; door_close(ctx); }
+        break;
+    case door_CLOSING:
+        if (evt == door_PRESS || evt == door_BLOCKED) { *state = door_OPENING; door_open(ctx); }
+        else if (evt == door_DONE) *state = door_CLOSED;
+        break;
+    case door_LOCKED:
+        if (evt == door_KEY) { *state = door_CLOSED; door_lock(ctx); }
+        break;
+    }
+    return *state;
+}
+
+#endif
@@ -0,0 +1,45 @@
+#pragma once
+#ifndef TEST_HOST_H
+#define TEST_HOST_H
+
+/*
+ * Host shims so the headers can be tested off target: a simulated clock
+ * and no-op interrupt control.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+
+#ifdef __GNUC__
+#define TEST_UNUSED __attribute__((unused))
+#else
+#define TEST_UNUSED
+#endif
+
+typedef unsigned long ms_t;
+
+static ms_t test_ms TEST_UNUSED;
+static ms_t test_us TEST_UNUSED;
+
+#define _clock_ms() test_ms
+#define _clock_us() test_us
+
+#define isr_off()
+#define isr_on()
+
+static unsigned test_failures TEST_UNUSED;
+
+/**
+ * Check a condition, reporting the failing line without stopping.
+ */
+#define check(cond) \
+  ((cond) ? (void)0 : (void)(++test_failures, fprintf(stderr, "%s:%d: check failed: %s\n", __FILE__, __LINE__, #cond)))
+
+/**
+ * Report the test result as the process exit status.
+ */
+#define test_done() \
+  (printf("%s: %s\n", __FILE__, test_failures ? "FAILED" : "ok"), test_failures ? EXIT_FAILURE : EXIT_SUCCESS)
+
+#endif
@@ -0,0 +1,38 @@
+#pragma once
+#ifndef TEST_SEQ_COUNT_H
+#define TEST_SEQ_COUNT_H
+
+/*
+ * Generators of the integers from 1 to 'n', shared by the seq.h tests and
+ * benchmarks.
+ */
+
+#include "seq.h"
+
+struct count {
+  seq_state;
+  int i;
+  int n;
+};
+
+static void count_init(struct count* self, int n) {
+  seq_init(self);
+  self->n = n;
+}
+
+static generator count(struct count* self, int* out) {
+  seq_begin(self);
+  for (self->i = 1; self->i <= self->n; ++self->i)
+    yield(self->i);
+  seq_end;
+}
+
+/* the same integers, a batch per resume */
+static generator count_n(struct count* self, int* out, size_t* n) {
+  seq_begin_n(self);
+  for (self->i = 1; self->i <= self->n; ++self->i)
+    yield_n(self->i);
+  seq_end_n;
+}
+
+#endif
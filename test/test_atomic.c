@@ -0,0 +1,167 @@
+#include "host.h"
+#include "atomic.h"
+#include <pthread.h>
+
+/*
+ * A writer publishes snapshots whose words all hold the same sequence
+ * number, while readers check that every copy they get is whole and that
+ * the sequence never goes backwards. A single core host only tears a copy
+ * when a thread is preempted mid-copy, so failures show up far more readily
+ * on a multicore host.
+ * 
+ * The triple buffer gets the same check with a single reader.
+ */
+
+#define WORDS  64
+#define WRITES 2000000UL
+
+struct snapshot {
+  uint32_t w[WORDS];
+};
+
+static volatile unsigned version;
+static volatile struct snapshot shared;
+static volatile int writing;
+
+static void* writer(void* arg) {
+  struct snapshot s;
+  uint32_t seq;
+  (void)arg;
+  for (seq = 1; seq <= WRITES; ++seq) {
+    int i;
+    for (i = 0; i < WORDS; ++i)
+      s.w[i] = seq;
+    atomic_writev(&version, &shared, &s, sizeof(s));
+  }
+  writing = 0;
+  return NULL;
+}
+
+struct reader_result {
+  unsigned long reads;
+  unsigned long torn;
+  unsigned long backwards;
+};
+
+static void* reader(void* arg) {
+  struct reader_result* r = (struct reader_result*)arg;
+  uint32_t last = 0;
+  do {
+    struct snapshot s;
+    int i;
+    atomic_readv(&version, &s, &shared, sizeof(s));
+    for (i = 1; i < WORDS && s.w[i] == s.w[0]; ++i);
+    r->torn += i < WORDS;
+    r->backwards += s.w[0] < last;
+    last = s.w[0];
+    ++r->reads;
+  } while (writing);
+  return NULL;
+}
+
+static void test_no_torn_reads(void) {
+  pthread_t w, r[2];
+  struct reader_result res[2] = { { 0, 0, 0 }, { 0, 0, 0 } };
+  int i;
+  writing = 1;
+  for (i = 0; i < 2; ++i)
+    check(pthread_create(&r[i], NULL, reader, &res[i]) == 0);
+  check(pthread_create(&w, NULL, writer, NULL) == 0);
+  pthread_join(w, NULL);
+  for (i = 0; i < 2; ++i) {
+    pthread_join(r[i], NULL);
+    check(res[i].reads > 0);
+    check(res[i].torn == 0);
+    check(res[i].backwards == 0);
+  }
+  check(shared.w[0] == WRITES && shared.w[WORDS - 1] == WRITES);
+  check(version == 2 * WRITES);
+}
+
+/* the three tbuf roles are always on distinct buffers */
+static int tbuf_roles_distinct(atomic_tbuf* t) {
+  unsigned mid = _atomic_peek(&t->mid) & 0x03;
+  return t->front != t->back && t->front != mid && t->back != mid
+      && t->front < 3 && t->back < 3 && mid < 3;
+}
+
+static void test_tbuf_rotation(void) {
+  atomic_tbuf t = ATOMIC_TBUF_INIT;
+  unsigned vals[3] = { 0, 0, 0 };
+  check(tbuf_roles_distinct(&t));
+  /* nothing published yet: the reader keeps its buffer */
+  check(atomic_tbuf_front(&t) == 0);
+  vals[atomic_tbuf_back(&t)] = 1;
+  atomic_tbuf_publish(&t);
+  check(tbuf_roles_distinct(&t));
+  check(vals[atomic_tbuf_front(&t)] == 1);
+  check(tbuf_roles_distinct(&t));
+  /* no new value: the same buffer again */
+  check(vals[atomic_tbuf_front(&t)] == 1);
+  /* two publications between reads: the reader gets the latest */
+  vals[atomic_tbuf_back(&t)] = 2;
+  atomic_tbuf_publish(&t);
+  check(tbuf_roles_distinct(&t));
+  vals[atomic_tbuf_back(&t)] = 3;
+  atomic_tbuf_publish(&t);
+  check(tbuf_roles_distinct(&t));
+  check(vals[atomic_tbuf_front(&t)] == 3);
+  check(tbuf_roles_distinct(&t));
+  /* the writer never gets the reader's buffer */
+  check(atomic_tbuf_back(&t) != t.front);
+  atomic_tbuf_init(&t);
+  check(tbuf_roles_distinct(&t));
+}
+
+static struct snapshot tbufs[3];
+static atomic_tbuf tb = ATOMIC_TBUF_INIT;
+
+static void* tbuf_writer(void* arg) {
+  uint32_t seq;
+  (void)arg;
+  for (seq = 1; seq <= WRITES; ++seq) {
+    struct snapshot* s = &tbufs[atomic_tbuf_back(&tb)];
+    int i;
+    for (i = 0; i < WORDS; ++i)
+      s->w[i] = seq;
+    atomic_tbuf_publish(&tb);
+  }
+  writing = 0;
+  return NULL;
+}
+
+static void* tbuf_reader(void* arg) {
+  struct reader_result* r = (struct reader_result*)arg;
+  uint32_t last = 0;
+  do {
+    const struct snapshot* s = &tbufs[atomic_tbuf_front(&tb)];
+    int i;
+    for (i = 1; i < WORDS && s->w[i] == s->w[0]; ++i);
+    r->torn += i < WORDS;
+    r->backwards += s->w[0] < last;
+    last = s->w[0];
+    ++r->reads;
+  } while (writing);
+  return NULL;
+}
+
+static void test_tbuf_threads(void) {
+  pthread_t w, r;
+  struct reader_result res = { 0, 0, 0 };
+  writing = 1;
+  check(pthread_create(&r, NULL, tbuf_reader, &res) == 0);
+  check(pthread_create(&w, NULL, tbuf_writer, NULL) == 0);
+  pthread_join(w, NULL);
+  pthread_join(r, NULL);
+  check(res.reads > 0);
+  check(res.torn == 0);
+  check(res.backwards == 0);
+  check(tbufs[atomic_tbuf_front(&tb)].w[0] == WRITES);
+}
+
+int main(void) {
+  test_no_torn_reads();
+  test_tbuf_rotation();
+  test_tbuf_threads();
+  return test_done();
+}
@@ -0,0 +1,54 @@
+#include "host.h"
+#include "atomic.h"
+
+/*
+ * Built once per atomic.h backend: test_atomic_cell_fence0 and
+ * test_atomic_cell_fence1.
+ */
+
+struct big {
+  uint32_t w[16];
+};
+
+/* the specialization picked for each type on this target */
+#if ATOMIC_FENCE
+static_assert(_atomic_native<uint32_t>::value, "uint32_t cells use atomic loads and stores");
+static_assert(_atomic_native<uint64_t>::value == (sizeof(void*) >= 8), "uint64_t cells are native only on 64-bit targets");
+#else
+static_assert(!_atomic_native<uint32_t>::value, "the volatile backend always uses the version check");
+static_assert(!_atomic_native<uint64_t>::value, "the volatile backend always uses the version check");
+#endif
+static_assert(!_atomic_native<big>::value, "large values always use the version check");
+static_assert(sizeof(atomic_cell<big>) > sizeof(big), "versioned cells carry a version");
+
+template<typename T>
+static bool round_trip(const T& x) {
+  atomic_cell<T> cell = atomic_cell<T>();
+  cell.write(x);
+  T y = cell.read();
+  return memcmp(&x, &y, sizeof(T)) == 0;
+}
+
+static void test_round_trip() {
+  check(round_trip<uint32_t>(0xDEADBEEFu));
+  check(round_trip<uint64_t>(0x0123456789ABCDEFull));
+  big b;
+  for (unsigned i = 0; i < 16; ++i)
+    b.w[i] = i * 0x01010101u;
+  check(round_trip(b));
+}
+
+static void test_versioned_write() {
+  atomic_cell<big> cell = atomic_cell<big>();
+  big b = big();
+  cell.write(b);
+  cell.write(b);
+  // each write leaves an even version, two steps on
+  check(cell.version == 4);
+}
+
+int main() {
+  test_round_trip();
+  test_versioned_write();
+  return test_done();
+}
@@ -0,0 +1,103 @@
+#include "host.h"
+#include "btn.h"
+#include <string.h>
+
+/*
+ * Check the vertical-counter banks against a per-input reference: an input
+ * toggles after 4 consecutive samples that differ from its settled state,
+ * and any matching sample restarts its count.
+ */
+
+struct model {
+    unsigned state[64];
+    unsigned count[64];
+};
+
+static uint64_t model_step(struct model* m, uint64_t sample, unsigned bits) {
+    uint64_t changed = 0;
+    unsigned i;
+    for (i = 0; i < bits; ++i) {
+        unsigned level = (unsigned)(sample >> i) & 1;
+        if (level == m->state[i]) {
+            m->count[i] = 0;
+        } else if (++m->count[i] == 4) {
+            m->state[i] = level;
+            m->count[i] = 0;
+            changed |= (uint64_t)1 << i;
+        }
+    }
+    return changed;
+}
+
+static void test_four_samples(void) {
+    btn_bank8 b = { 0, 0, 0 };
+    /* three differing samples aren't enough */
+    check(btn_bank8_poll(&b, 0x01) == 0);
+    check(btn_bank8_poll(&b, 0x01) == 0);
+    check(btn_bank8_poll(&b, 0x01) == 0);
+    check(b.state == 0);
+    check(btn_bank8_poll(&b, 0x01) == 0x01);
+    check(b.state == 0x01);
+    /* a bounce back to the settled level restarts the count */
+    check(btn_bank8_poll(&b, 0x00) == 0);
+    check(btn_bank8_poll(&b, 0x00) == 0);
+    check(btn_bank8_poll(&b, 0x01) == 0);
+    check(btn_bank8_poll(&b, 0x00) == 0);
+    check(btn_bank8_poll(&b, 0x00) == 0);
+    check(btn_bank8_poll(&b, 0x00) == 0);
+    check(btn_bank8_poll(&b, 0x00) == 0x01);
+    check(b.state == 0);
+}
+
+static void test_inputs_independent(void) {
+    btn_bank8 b = { 0x0F, 0, 0 };
+    uint8_t changed;
+    /* bit 7 goes high two samples before bit 0 goes low */
+    changed = btn_bank8_poll(&b, 0x8F);
+    changed |= btn_bank8_poll(&b, 0x8F);
+    check(changed == 0);
+    changed = btn_bank8_poll(&b, 0x8E);
+    changed |= btn_bank8_poll(&b, 0x8E);
+    check(changed == 0x80);
+    check(b.state == 0x8F);
+    changed = btn_bank8_poll(&b, 0x8E);
+    changed |= btn_bank8_poll(&b, 0x8E);
+    check(changed == 0x01);
+    check(b.state == 0x8E);
+}
+
+/* every bank width against the reference on a noisy random input */
+static void test_matches_model(void) {
+    struct model m8, m16, m32, m64;
+    btn_bank8 b8 = { 0, 0, 0 };
+    btn_bank16 b16 = { 0, 0, 0 };
+    btn_bank32 b32 = { 0, 0, 0 };
+    btn_bank64 b64 = { 0, 0, 0 };
+    uint64_t x = 1, level = 0;
+    unsigned i, bad = 0;
+    memset(&m8, 0, sizeof(m8));
+    m16 = m32 = m64 = m8;
+    for (i = 0; i < 100000; ++i) {
+        uint64_t sample;
+        x ^= x << 13;
+        x ^= x >> 7;
+        x ^= x << 17;
+        /* move a few levels now and then, with bounces on every sample */
+        if (i % 16 == 0)
+            level ^= x & (x >> 11) & (x >> 23);
+        sample = level ^ (x & (x >> 5) & (x >> 9));
+        bad += btn_bank8_poll(&b8, (uint8_t)sample) != model_step(&m8, sample, 8);
+        bad += btn_bank16_poll(&b16, (uint16_t)sample) != model_step(&m16, sample, 16);
+        bad += btn_bank32_poll(&b32, (uint32_t)sample) != model_step(&m32, sample, 32);
+        bad += btn_bank64_poll(&b64, sample) != model_step(&m64, sample, 64);
+    }
+    check(bad == 0);
+    check(b64.state != 0);
+}
+
+int main(void) {
+    test_four_samples();
+    test_inputs_independent();
+    test_matches_model();
+    return test_done();
+}
@@ -0,0 +1,87 @@
+#include "host.h"
+#include "btn.h"
+
+/*
+ * Drive a gesture recognizer through a press/release script against the
+ * simulated clock, waking it at each edge and at each deadline it reports,
+ * as a sleeping scheduler would.
+ */
+
+#define MAX_EVENTS 16
+
+struct result {
+    uint8_t evt[MAX_EVENTS];
+    ms_t at[MAX_EVENTS];
+    unsigned n;
+};
+
+static void run(ms_t start, const unsigned* edges, unsigned nedges, unsigned end, struct result* r) {
+    btn_gesture g = { 0, 0 };
+    unsigned pressed = 0, e = 0, t;
+    r->n = 0;
+    for (t = 0; t <= end; ++t) {
+        ms_t wake;
+        unsigned due, edge = e < nedges && edges[e] == t;
+        test_ms = start + t;
+        due = btn_gesture_wake(&g, &wake) && wake == test_ms;
+        if (edge) {
+            pressed = !pressed;
+            ++e;
+        }
+        if (edge || due) {
+            uint8_t evt = btn_gesture_update(&g, pressed, clock_ms());
+            if (evt != BTN_NONE && r->n < MAX_EVENTS) {
+                r->evt[r->n] = evt;
+                r->at[r->n++] = t;
+            }
+        }
+    }
+}
+
+static void test_click(ms_t start) {
+    static const unsigned edges[] = { 10, 60 };
+    struct result r;
+    run(start, edges, 2, 1000, &r);
+    check(r.n == 1);
+    check(r.evt[0] == BTN_CLICK && r.at[0] == 60 + BTN_DOUBLE_MS);
+}
+
+static void test_double(ms_t start) {
+    static const unsigned edges[] = { 10, 60, 100, 150 };
+    struct result r;
+    run(start, edges, 4, 1000, &r);
+    check(r.n == 1);
+    check(r.evt[0] == BTN_DOUBLE && r.at[0] == 150);
+}
+
+static void test_long_repeat(ms_t start) {
+    static const unsigned edges[] = { 10, 900 };
+    struct result r;
+    unsigned i;
+    run(start, edges, 2, 1000, &r);
+    check(r.n == 4);
+    check(r.evt[0] == BTN_LONG && r.at[0] == 10 + BTN_LONG_MS);
+    for (i = 1; i < r.n; ++i)
+        check(r.evt[i] == BTN_REPEAT && r.at[i] == r.at[i - 1] + BTN_REPEAT_MS);
+}
+
+static void test_idle(void) {
+    btn_gesture g = { 0, 0 };
+    ms_t wake;
+    check(!btn_gesture_wake(&g, &wake));
+    check(btn_gesture_update(&g, 0, 12345) == BTN_NONE);
+    check(!btn_gesture_wake(&g, &wake));
+}
+
+int main(void) {
+    /* starting just before ms_t wraps puts each deadline across the wrap */
+    const ms_t starts[] = { 0, 1000000, (ms_t)-300 };
+    unsigned i;
+    for (i = 0; i < sizeof(starts) / sizeof(starts[0]); ++i) {
+        test_click(starts[i]);
+        test_double(starts[i]);
+        test_long_repeat(starts[i]);
+    }
+    test_idle();
+    return test_done();
+}
@@ -0,0 +1,113 @@
+#include "host.h"
+/* btn.h mustn't need interrupt control, as on a target without Arduino's */
+#undef isr_off
+#undef isr_on
+#include "btn.h"
+
+#ifdef EVQ_H
+#error "btn.h shouldn't pull in evq.h"
+#endif
+
+/*
+ * Scan a simulated 4x4 key matrix, collecting the reported key events in a
+ * small queue that can be made to refuse events.
+ */
+
+#define ROWS 4
+
+struct keys {
+    uint8_t ev[32];
+    unsigned n;
+    unsigned room;
+};
+
+static unsigned emit(void* ctx, uint8_t ev) {
+    struct keys* k = (struct keys*)ctx;
+    if (k->n >= k->room)
+        return 0;
+    k->ev[k->n++] = ev;
+    return 1;
+}
+
+/* the columns read on each row, as the matrix wiring would show them */
+static void scan(btn_matrix* m, const uint8_t* pressed, unsigned scans, struct keys* k) {
+    unsigned i, r;
+    for (i = 0; i < scans; ++i)
+        for (r = 0; r < ROWS; ++r)
+            check(btn_matrix_step(m, pressed[m->row], emit, k) == (r + 1) % ROWS);
+}
+
+static void test_press_release(void) {
+    btn_matrix m;
+    struct keys k = { { 0 }, 0, 32 };
+    uint8_t pressed[ROWS] = { 0, 0, 0x04, 0 };
+    check(btn_matrix_init(&m, ROWS) == 0);
+    scan(&m, pressed, 3, &k);
+    check(k.n == 0);
+    scan(&m, pressed, 1, &k);
+    check(k.n == 1);
+    check(k.ev[0] == (BTN_KEY_PRESS | btn_key(2, 2)));
+    check(btn_key_pressed(k.ev[0]));
+    check(btn_key_index(k.ev[0]) == 18);
+    pressed[2] = 0;
+    scan(&m, pressed, 4, &k);
+    check(k.n == 2);
+    check(k.ev[1] == btn_key(2, 2));
+    check(m.ghost == 0);
+}
+
+static void test_ghost(void) {
+    btn_matrix m;
+    struct keys k = { { 0 }, 0, 32 };
+    /* keys (0,0), (0,1) and (1,0) held: (1,1) reads as pressed too */
+    uint8_t pressed[ROWS] = { 0x01, 0, 0, 0 };
+    btn_matrix_init(&m, ROWS);
+    scan(&m, pressed, 4, &k);
+    check(k.n == 1);
+    check(k.ev[0] == (BTN_KEY_PRESS | btn_key(0, 0)));
+    pressed[0] = 0x03;
+    scan(&m, pressed, 4, &k);
+    check(k.n == 2);
+    check(k.ev[1] == (BTN_KEY_PRESS | btn_key(0, 1)));
+    pressed[1] = 0x03;
+    scan(&m, pressed, 8, &k);
+    /* row 0 is ghosted from the moment row 1 settles, so nothing new */
+    check(k.n == 2);
+    check(m.ghost == 0x03);
+    /* releasing (0,0) clears the phantom (1,1): the release is reported and
+       row 1, no longer ambiguous, reports its real key */
+    pressed[0] = 0x02;
+    pressed[1] = 0x01;
+    scan(&m, pressed, 4, &k);
+    check(k.n == 4);
+    check(k.ev[2] == btn_key(0, 0));
+    check(k.ev[3] == (BTN_KEY_PRESS | btn_key(1, 0)));
+    check(m.ghost == 0);
+}
+
+static void test_retry(void) {
+    btn_matrix m;
+    struct keys k = { { 0 }, 0, 1 };
+    uint8_t pressed[ROWS] = { 0, 0x05, 0, 0 };
+    btn_matrix_init(&m, ROWS);
+    scan(&m, pressed, 4, &k);
+    /* only the first of two presses fits */
+    check(k.n == 1);
+    check(k.ev[0] == (BTN_KEY_PRESS | btn_key(1, 0)));
+    scan(&m, pressed, 2, &k);
+    check(k.n == 1);
+    /* the dropped press is offered again on the next scan of row 1 */
+    k.room = 32;
+    scan(&m, pressed, 1, &k);
+    check(k.n == 2);
+    check(k.ev[1] == (BTN_KEY_PRESS | btn_key(1, 2)));
+    scan(&m, pressed, 4, &k);
+    check(k.n == 2);
+}
+
+int main(void) {
+    test_press_release();
+    test_ghost();
+    test_retry();
+    return test_done();
+}
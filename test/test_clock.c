@@ -0,0 +1,92 @@
+#include "host.h"
+
+/* one clock for both source files */
+extern ms_t shared_ms, shared_us;
+#undef _clock_ms
+#undef _clock_us
+#define _clock_ms() shared_ms
+#define _clock_us() shared_us
+
+#define CLOCK_IMPL
+#define CLOCK_PROFILE
+#include "clock.h"
+
+ms_t shared_ms, shared_us;
+
+/* how far the clocks read by test_clock_read.c advance on each read */
+static ms_t tick_ms, tick_us;
+
+ms_t next_ms(void) {
+  ms_t now = shared_ms;
+  shared_ms += tick_ms;
+  return now;
+}
+
+ms_t next_us(void) {
+  ms_t now = shared_us;
+  shared_us += tick_us;
+  return now;
+}
+
+/* in test_clock_read.c, so the state must be shared to see the syncs here */
+uint64_t read_ms64(void);
+uint64_t read_us64(void);
+uint64_t read_ns(cycles_t cycles);
+void run_profiled(void);
+
+static void test_wrap_across_files(void) {
+  shared_ms = 0xFFFFFFF0UL;
+  shared_us = 0xFFFFFF00UL;
+  clock_sync();
+  check(read_ms64() == 0xFFFFFFF0ULL);
+  check(read_us64() == 0xFFFFFF00ULL);
+  /* a wrap since the last sync is still counted */
+  shared_ms = 5;
+  shared_us = 7;
+  check(read_ms64() == 0x100000005ULL);
+  check(read_us64() == 0x100000007ULL);
+  clock_sync();
+  shared_ms = 0x80000000UL;
+  check(read_ms64() == 0x180000000ULL);
+  clock_sync();
+  shared_ms = 3;
+  check(read_ms64() == 0x200000003ULL);
+  clock_sync();
+  check(read_ms64() == 0x200000003ULL);
+  check(read_us64() == 0x100000007ULL);
+}
+
+/* the clock is read once, so a wrap right after the read isn't half seen */
+static void test_wrap_while_reading(void) {
+  shared_ms = 0xFFFFFFFFUL;
+  shared_us = 0xFFFFFFFFUL;
+  clock_sync();
+  tick_ms = tick_us = 1;
+  check(read_ms64() == 0x2FFFFFFFFULL);
+  check(read_ms64() == 0x300000000ULL);
+  check(read_us64() == 0x1FFFFFFFFULL);
+  check(read_us64() == 0x200000000ULL);
+  tick_ms = tick_us = 0;
+}
+
+static void test_cycles_across_files(void) {
+  /* 250MHz, 4ns per cycle */
+  clock_cycles_hz(250000000UL);
+  check(read_ns(1000) == 4000);
+}
+
+static void test_profile_across_files(void) {
+  run_profiled();
+  run_profiled();
+  check(clock_nprofiles == 1);
+  check(strcmp(clock_profiles[0].name, "section") == 0);
+  check(clock_profiles[0].count == 2);
+}
+
+int main(void) {
+  test_wrap_across_files();
+  test_wrap_while_reading();
+  test_cycles_across_files();
+  test_profile_across_files();
+  return test_done();
+}
@@ -0,0 +1,31 @@
+#include "host.h"
+
+/* a live clock, which may advance between any two reads */
+ms_t next_ms(void);
+ms_t next_us(void);
+extern ms_t shared_us;
+#undef _clock_ms
+#undef _clock_us
+#define _clock_ms() next_ms()
+#define _clock_us() next_us()
+
+#define CLOCK_PROFILE
+#include "clock.h"
+
+uint64_t read_ms64(void) {
+  return clock_ms64();
+}
+
+uint64_t read_us64(void) {
+  return clock_us64();
+}
+
+uint64_t read_ns(cycles_t cycles) {
+  return clock_cycles_ns(cycles);
+}
+
+void run_profiled(void) {
+  PROFILE_BEGIN(section);
+  shared_us += 10;
+  PROFILE_END(section);
+}
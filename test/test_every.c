@@ -0,0 +1,167 @@
+#include "host.h"
+#include "every.h"
+
+static unsigned long now_ms(void) {
+  return test_ms;
+}
+
+/* the most blocks sharing a period that run on one loop pass */
+static unsigned worst_plain(void) {
+  unsigned worst = 0;
+  for (test_ms = 0; test_ms < 1000; ++test_ms) {
+    unsigned ran = 0;
+    every_phase(100, 0, now_ms) ++ran;
+    every_phase(100, 0, now_ms) ++ran;
+    every_phase(100, 0, now_ms) ++ran;
+    every_phase(100, 0, now_ms) ++ran;
+    every_phase(100, 0, now_ms) ++ran;
+    every_phase(100, 0, now_ms) ++ran;
+    every_phase(100, 0, now_ms) ++ran;
+    every_phase(100, 0, now_ms) ++ran;
+    if (ran > worst) worst = ran;
+  }
+  return worst;
+}
+
+static unsigned worst_stagger(void) {
+  unsigned worst = 0, total = 0;
+  for (test_ms = 0; test_ms < 1000; ++test_ms) {
+    unsigned ran = 0;
+    every_stagger(100, now_ms) ++ran;
+    every_stagger(100, now_ms) ++ran;
+    every_stagger(100, now_ms) ++ran;
+    every_stagger(100, now_ms) ++ran;
+    every_stagger(100, now_ms) ++ran;
+    every_stagger(100, now_ms) ++ran;
+    every_stagger(100, now_ms) ++ran;
+    every_stagger(100, now_ms) ++ran;
+    if (ran > worst) worst = ran;
+    total += ran;
+  }
+  /* staggering spreads the runs without dropping any */
+  check(total >= 8 * 9);
+  return worst;
+}
+
+static void test_worst_case_pass(void) {
+  check(worst_plain() == 8);
+  check(worst_stagger() == 1);
+}
+
+static unsigned run_phase(unsigned long t) {
+  unsigned ran = 0;
+  test_ms = t;
+  every_phase(100, 50, now_ms) ++ran;
+  return ran;
+}
+
+static void test_phase(void) {
+  check(run_phase(0) == 0);
+  check(run_phase(49) == 0);
+  check(run_phase(50) == 0);
+  check(run_phase(149) == 0);
+  check(run_phase(150) == 1);
+  check(run_phase(150) == 0);
+  check(run_phase(249) == 0);
+  check(run_phase(250) == 1);
+}
+
+static unsigned run_period(unsigned long t, unsigned long period) {
+  unsigned ran = 0;
+  test_ms = t;
+  every(period, now_ms) ++ran;
+  return ran;
+}
+
+static void test_runtime_period(void) {
+  check(run_period(0, 30) == 0);
+  check(run_period(30, 30) == 1);
+  check(run_period(59, 30) == 0);
+  check(run_period(60, 30) == 1);
+  check(run_period(80, 10) == 1);
+}
+
+static unsigned run_late(unsigned long t) {
+  unsigned ran = 0;
+  test_ms = t;
+  every_policy(100, 0, now_ms, EVERY_DRIFT) ++ran;
+  return ran;
+}
+
+static void test_first_reached_late(void) {
+  /* first reached more than half the clock range after boot */
+  unsigned long t = (unsigned long)-1 / 2 + 1000;
+  check(run_late(t) == 1);
+  check(run_late(t + 99) == 0);
+  check(run_late(t + 100) == 1);
+}
+
+static unsigned run_wrap(unsigned long t) {
+  unsigned ran = 0;
+  test_ms = t;
+  every_policy(100, 0, now_ms, EVERY_DRIFT) ++ran;
+  return ran;
+}
+
+static void test_wrap(void) {
+  check(run_wrap((unsigned long)-250) == 1);
+  check(run_wrap((unsigned long)-160) == 0);
+  check(run_wrap((unsigned long)-150) == 1);
+  check(run_wrap((unsigned long)-50) == 1);
+  check(run_wrap(49) == 0);
+  check(run_wrap(50) == 1);
+  check(run_wrap(149) == 0);
+  check(run_wrap(150) == 1);
+}
+
+static unsigned run_catchup(unsigned long t) {
+  unsigned ran = 0;
+  test_ms = t;
+  every_policy(100, 0, now_ms, EVERY_CATCHUP) ++ran;
+  return ran;
+}
+
+static unsigned run_skip(unsigned long t) {
+  unsigned ran = 0;
+  test_ms = t;
+  every_policy(100, 0, now_ms, EVERY_SKIP) ++ran;
+  return ran;
+}
+
+static unsigned run_drift(unsigned long t) {
+  unsigned ran = 0;
+  test_ms = t;
+  every_policy(100, 0, now_ms, EVERY_DRIFT) ++ran;
+  return ran;
+}
+
+static void test_policies(void) {
+  /* late by 2.5 periods: catch up the missed runs on consecutive passes */
+  check(run_catchup(100) == 1);
+  check(run_catchup(350) == 1);
+  check(run_catchup(350) == 1);
+  check(run_catchup(350) == 0);
+  check(run_catchup(400) == 1);
+  /* skip the missed runs but keep the phase */
+  check(run_skip(100) == 1);
+  check(run_skip(350) == 1);
+  check(run_skip(350) == 0);
+  check(run_skip(399) == 0);
+  check(run_skip(400) == 1);
+  /* restart the period from the late run */
+  check(run_drift(100) == 1);
+  check(run_drift(350) == 1);
+  check(run_drift(400) == 0);
+  check(run_drift(449) == 0);
+  check(run_drift(450) == 1);
+}
+
+int main(void) {
+  test_worst_case_pass();
+  test_phase();
+  test_runtime_period();
+  test_first_reached_late();
+  test_wrap();
+  test_policies();
+  return test_done();
+}
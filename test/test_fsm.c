@@ -0,0 +1,57 @@
+#include "host.h"
+#include "fsm_door.h"
+#include <string.h>
+
+static void test_step(void) {
+    struct door d = { 0, 0, 0 };
+    uint8_t s = door_CLOSED;
+    check(door_step(&s, door_TIMEOUT, &d) == door_CLOSED);
+    check(door_step(&s, door_PRESS, &d) == door_OPENING);
+    check(d.opens == 1);
+    check(door_step(&s, door_DONE, &d) == door_OPEN);
+    check(door_step(&s, door_TIMEOUT, &d) == door_CLOSING);
+    check(d.closes == 1);
+    /* blocked while closing reopens */
+    check(door_step(&s, door_BLOCKED, &d) == door_OPENING);
+    check(d.opens == 2);
+    check(door_step(&s, door_DONE, &d) == door_OPEN);
+    check(door_step(&s, door_TIMEOUT, &d) == door_CLOSING);
+    check(door_step(&s, door_DONE, &d) == door_CLOSED);
+    check(door_step(&s, door_KEY, &d) == door_LOCKED);
+    /* locked ignores the button */
+    check(door_step(&s, door_PRESS, &d) == door_LOCKED);
+    check(d.opens == 2);
+    check(door_step(&s, door_KEY, &d) == door_CLOSED);
+    check(d.locks == 2);
+    check(s == door_CLOSED);
+}
+
+static void test_table_layout(void) {
+    check(door_NSTATES == 5 && door_NEVENTS == 5);
+    check(sizeof(door_table) / sizeof(door_table[0]) == door_NSTATES * door_NEVENTS);
+    check(door_table[door_CLOSING_BLOCKED].next == door_OPENING);
+    check(door_table[door_CLOSING_BLOCKED].action == door_open);
+    check(door_table[door_OPEN_DONE].action == 0);
+}
+
+/* the table and the switch agree on every state and event */
+static void test_matches_switch(void) {
+    unsigned st, evt, bad = 0;
+    for (st = 0; st < door_NSTATES; ++st) {
+        for (evt = 0; evt < door_NEVENTS; ++evt) {
+            struct door a = { 0, 0, 0 }, b = { 0, 0, 0 };
+            uint8_t sa = (uint8_t)st, sb = (uint8_t)st;
+            door_step(&sa, evt, &a);
+            door_switch_step(&sb, evt, &b);
+            bad += sa != sb || memcmp(&a, &b, sizeof(a)) != 0;
+        }
+    }
+    check(bad == 0);
+}
+
+int main(void) {
+    test_step();
+    test_table_layout();
+    test_matches_switch();
+    return test_done();
+}
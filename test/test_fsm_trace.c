@@ -0,0 +1,140 @@
+#include "host.h"
+#define FSM_TRACE
+#include "fsm_door.h"
+#include <string.h>
+
+/* step the door at the given time */
+static uint8_t at(ms_t t, uint8_t* s, unsigned evt, struct door* d) {
+    test_ms = t;
+    return door_step(s, evt, d);
+}
+
+static void test_fsm_record_replay(void) {
+    struct door d = { 0, 0, 0 };
+    uint8_t s = door_CLOSED;
+    fsm_trace copy;
+    memset(&door_trace, 0, sizeof(door_trace));
+    at(100, &s, door_PRESS, &d);
+    at(150, &s, door_DONE, &d);
+    at(1150, &s, door_TIMEOUT, &d);
+    at(1170, &s, door_BLOCKED, &d);
+    at(1200, &s, door_DONE, &d);
+    at(2200, &s, door_TIMEOUT, &d);
+    at(2250, &s, door_DONE, &d);
+    at(2300, &s, door_KEY, &d);
+    check(fsm_trace_len(&door_trace) == 8);
+    check(fsm_trace_at(&door_trace, 0)->state == door_CLOSED);
+    check(fsm_trace_at(&door_trace, 0)->next == door_OPENING);
+    check(fsm_trace_at(&door_trace, 7)->next == door_LOCKED);
+    check(fsm_trace_at(&door_trace, 3)->time == 1170);
+
+    /* replay a copy, since the replay itself is traced */
+    copy = door_trace;
+    memset(&d, 0, sizeof(d));
+    check(fsm_replay(&copy, door_step, &d) == 8);
+    check(d.opens == 2 && d.closes == 2 && d.locks == 1);
+    check(fsm_trace_len(&door_trace) == 16);
+
+    /* a record the machine doesn't reproduce stops the replay there */
+    copy.recs[5].next = door_OPEN;
+    check(fsm_replay(&copy, door_step, &d) == 5);
+}
+
+static void test_fsm_stats(void) {
+    struct door d = { 0, 0, 0 };
+    uint8_t s = door_CLOSED;
+    uint16_t count[door_NSTATES * door_NEVENTS];
+    uint32_t dwell[door_NSTATES];
+    memset(&door_trace, 0, sizeof(door_trace));
+    memset(count, 0, sizeof(count));
+    memset(dwell, 0, sizeof(dwell));
+    at(0, &s, door_PRESS, &d);          /* OPENING for 50 */
+    at(50, &s, door_DONE, &d);          /* OPEN for 1000 */
+    at(1050, &s, door_PRESS, &d);       /* ignored, still OPEN for 500 more */
+    at(1550, &s, door_TIMEOUT, &d);     /* CLOSING for 20 */
+    at(1570, &s, door_DONE, &d);        /* CLOSED, the last record */
+    fsm_trace_stats(&door_trace, door_NEVENTS, count, dwell);
+    check(count[door_CLOSED * door_NEVENTS + door_PRESS] == 1);
+    check(count[door_OPEN * door_NEVENTS + door_PRESS] == 1);
+    check(count[door_CLOSING * door_NEVENTS + door_DONE] == 1);
+    check(count[door_OPEN * door_NEVENTS + door_KEY] == 0);
+    check(dwell[door_OPENING] == 50);
+    check(dwell[door_OPEN] == 1500);
+    check(dwell[door_CLOSING] == 20);
+    check(dwell[door_CLOSED] == 0);
+}
+
+static void test_fsm_trace_wrap(void) {
+    struct door d = { 0, 0, 0 };
+    uint8_t s = door_CLOSED;
+    unsigned i;
+    memset(&door_trace, 0, sizeof(door_trace));
+    for (i = 0; i < FSM_TRACE_SIZE + 3; ++i)
+        at(i, &s, door_TIMEOUT, &d);
+    check(fsm_trace_len(&door_trace) == FSM_TRACE_SIZE);
+    /* oldest first */
+    check(fsm_trace_at(&door_trace, 0)->time == 3);
+    check(fsm_trace_at(&door_trace, FSM_TRACE_SIZE - 1)->time == FSM_TRACE_SIZE + 2);
+}
+
+/* a hierarchical machine that defers DATA until it's READY */
+
+static unsigned received;
+static void rx(void* c) { (void)c; ++received; }
+
+#define PIPE_STATES(X, m)              \
+    X(m, IDLE,   ROOT,   0, 0)         \
+    X(m, ACTIVE, ROOT,   0, 0)         \
+    X(m, WAIT,   ACTIVE, 0, 0)         \
+    X(m, READY,  ACTIVE, 0, 0)
+#define PIPE_EVENTS(X, m) X(m, GO) X(m, DATA) X(m, OK) X(m, STOP)
+#define PIPE_RULES(X, m)            \
+    X(m, IDLE,   GO,   WAIT,  0)    \
+    X(m, WAIT,   DATA, DEFER, 0)    \
+    X(m, WAIT,   OK,   READY, 0)    \
+    X(m, READY,  DATA, NONE,  rx)   \
+    X(m, ACTIVE, STOP, IDLE,  0)
+
+hsm_define(pipe, PIPE_STATES, PIPE_EVENTS, PIPE_RULES)
+
+static void test_hsm_record_replay(void) {
+    static hsm m, r;
+    static fsm_trace trace, copy;
+    memset(&trace, 0, sizeof(trace));
+    received = 0;
+    hsm_init(&m, &pipe_def, pipe_IDLE, 0);
+    m.trace = &trace;
+    hsm_post(&m, pipe_GO);
+    hsm_post(&m, pipe_DATA);    /* deferred */
+    hsm_post(&m, pipe_DATA);    /* deferred */
+    hsm_post(&m, pipe_OK);      /* recalls both */
+    hsm_post(&m, pipe_DATA);
+    hsm_post(&m, pipe_STOP);
+    hsm_post(&m, pipe_DATA);    /* dropped while IDLE */
+    check(hsm_run(&m) == 9);
+    check(received == 3);
+    check(fsm_trace_len(&trace) == 9);
+    /* a deferral records no state change */
+    check(fsm_trace_at(&trace, 1)->state == pipe_WAIT && fsm_trace_at(&trace, 1)->next == pipe_WAIT);
+    /* the recalled events are dispatched right after OK */
+    check(fsm_trace_at(&trace, 3)->event == pipe_OK);
+    check(fsm_trace_at(&trace, 4)->event == pipe_DATA && fsm_trace_at(&trace, 4)->state == pipe_READY);
+
+    copy = trace;
+    received = 0;
+    hsm_init(&r, &pipe_def, pipe_IDLE, 0);
+    r.trace = &trace;
+    check(hsm_replay(&r, &copy) == 9);
+    check(received == 3);
+    check(r.state == pipe_IDLE);
+    /* replaying doesn't extend the machine's own trace */
+    check(fsm_trace_len(&trace) == 9);
+}
+
+int main(void) {
+    test_fsm_record_replay();
+    test_fsm_stats();
+    test_fsm_trace_wrap();
+    test_hsm_record_replay();
+    return test_done();
+}
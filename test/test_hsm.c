@@ -0,0 +1,83 @@
+#include "host.h"
+#include "fsm.h"
+#include <string.h>
+
+/* a connection protocol: HANDSHAKE defers DATA until the link is OPEN */
+
+static char log_[1024];
+static int logn;
+
+#define LOG(s) static void s(void* c) { (void)c; logn += snprintf(log_ + logn, sizeof(log_) - logn, #s " "); }
+LOG(syn) LOG(drop) LOG(rx) LOG(open_in) LOG(open_out)
+
+#define LINK_STATES(X, m)                     \
+    X(m, IDLE,      ROOT,   0,       0)       \
+    X(m, ACTIVE,    ROOT,   0,       drop)    \
+    X(m, HANDSHAKE, ACTIVE, syn,     0)       \
+    X(m, OPEN,      ACTIVE, open_in, open_out)
+#define LINK_EVENTS(X, m) X(m, CONNECT) X(m, ACK) X(m, DATA) X(m, CLOSE) X(m, RESET)
+#define LINK_RULES(X, m)                   \
+    X(m, IDLE,      CONNECT, HANDSHAKE, 0) \
+    X(m, HANDSHAKE, ACK,     OPEN,      0) \
+    X(m, HANDSHAKE, DATA,    DEFER,     0) \
+    X(m, OPEN,      DATA,    NONE,      rx) \
+    X(m, OPEN,      RESET,   OPEN,      0) \
+    X(m, ACTIVE,    CLOSE,   IDLE,      0)
+
+hsm_define(link, LINK_STATES, LINK_EVENTS, LINK_RULES)
+
+static void test_protocol(void) {
+    static hsm m;
+    logn = 0;
+    hsm_init(&m, &link_def, link_IDLE, 0);
+    hsm_post(&m, link_DATA);        /* dropped while IDLE */
+    hsm_post(&m, link_CONNECT);
+    hsm_post(&m, link_DATA);        /* deferred until OPEN */
+    hsm_post(&m, link_DATA);
+    hsm_post(&m, link_ACK);
+    hsm_post(&m, link_RESET);       /* self transition exits and re-enters */
+    hsm_post(&m, link_CLOSE);       /* handled by the parent */
+    check(hsm_run(&m) == 9);
+    check(m.state == link_IDLE);
+    check(strcmp(log_, "syn open_in rx rx open_out open_in open_out drop ") == 0);
+}
+
+static void test_deferred_full(void) {
+    static hsm m;
+    unsigned i;
+    hsm_init(&m, &link_def, link_IDLE, 0);
+    check(hsm_dispatch(&m, link_CONNECT));
+    for (i = 0; i < EQUEUE_SIZE; ++i)
+        check(hsm_dispatch(&m, link_DATA));
+    /* no room left to defer, so the event is reported as dropped */
+    check(!hsm_dispatch(&m, link_DATA));
+    check(equeue_size(&m.deferred) == EQUEUE_SIZE);
+
+    /* recalled events that don't fit in a full queue stay deferred */
+    for (i = 0; i < EQUEUE_SIZE - 2; ++i)
+        check(hsm_post(&m, link_RESET));
+    check(hsm_dispatch(&m, link_ACK));
+    check(m.state == link_OPEN);
+    check(equeue_size(&m.evts) == EQUEUE_SIZE);
+    check(equeue_size(&m.deferred) == EQUEUE_SIZE - 2);
+
+    /* each RESET re-enters OPEN and recalls more, so nothing is lost */
+    logn = 0;
+    hsm_run(&m);
+    check(equeue_size(&m.deferred) == 0);
+    {
+        unsigned rx = 0;
+        const char* p = log_;
+        while ((p = strstr(p, "rx")) != NULL) {
+            ++rx;
+            p += 2;
+        }
+        check(rx == EQUEUE_SIZE);
+    }
+}
+
+int main(void) {
+    test_protocol();
+    test_deferred_full();
+    return test_done();
+}
@@ -0,0 +1,78 @@
+#include "host.h"
+#include "led.h"
+#include <string.h>
+
+/* records the bus transfers of a display chain */
+struct bus {
+  unsigned xfers;
+  unsigned len;
+  byte frame[2 * LED_CASCADE_MAX];
+};
+
+static void bus_xfer(void* ctx, const byte* frame, unsigned len) {
+  bus* b = (bus*)ctx;
+  ++b->xfers;
+  b->len = len;
+  memcpy(b->frame, frame, len);
+}
+
+static void test_refresh_counts() {
+  bus b = bus();
+  led_cascade leds;
+  byte code[8];
+  test_ms = 1000;
+  // init: test, decode, scan limit, intensity and shutdown frames
+  led_cascade_init(&leds, 3, bus_xfer, &b, 20);
+  check(b.xfers == 5);
+  check(b.len == 6);
+  check(b.frame[0] == LED_REG_SHUTDOWN && b.frame[1] == 1);
+  // the first refresh sends every row
+  check(led_cascade_flush(&leds) == 8);
+  check(b.xfers == 13);
+  // nothing changed, nothing sent
+  test_ms += 20;
+  check(led_cascade_flush(&leds) == 0);
+  check(b.xfers == 13);
+  // a brightness change alone is one frame
+  led_cascade_intensity(&leds, 1, 3);
+  check(led_cascade_flush(&leds) == 1);
+  check(b.xfers == 14);
+  check(b.frame[0] == LED_REG_INTENSITY && b.frame[1] == 8);
+  check(b.frame[2] == LED_REG_INTENSITY && b.frame[3] == 3);
+  // a change within the period waits for the next one
+  led_fmt_uint(code, 12345678, 8, false);
+  led_cascade_digits(&leds, 0, code);
+  test_ms += 19;
+  check(led_cascade_flush(&leds) == 0);
+  check(b.xfers == 14);
+  test_ms += 1;
+  check(led_cascade_flush(&leds) == 8);
+  check(b.xfers == 22);
+  // only the changed row is resent
+  test_ms += 20;
+  led_fmt_uint(code, 12345679, 8, false);
+  led_cascade_digits(&leds, 0, code);
+  check(led_cascade_flush(&leds) == 1);
+  check(b.xfers == 23);
+}
+
+static void test_frame_order() {
+  bus b = bus();
+  led_cascade leds;
+  test_ms = 5000;
+  led_cascade_init(&leds, 3, bus_xfer, &b, 0);
+  led_cascade_flush(&leds);
+  led_cascade_row(&leds, 0, 4, 0xA0);
+  led_cascade_row(&leds, 2, 4, 0x0C);
+  check(led_cascade_flush(&leds) == 1);
+  // the farthest display's pair is shifted out first
+  const byte expect[] = { 5, 0x0C, 5, 0x00, 5, 0xA0 };
+  check(b.len == sizeof(expect));
+  check(memcmp(b.frame, expect, sizeof(expect)) == 0);
+}
+
+int main() {
+  test_refresh_counts();
+  test_frame_order();
+  return test_done();
+}
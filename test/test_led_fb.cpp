@@ -0,0 +1,47 @@
+#include "host.h"
+#include "led.h"
+
+static void test_flush_changed_digits() {
+  LedControl led;
+  led_fb fb;
+  led_fb_init(&fb);
+  // the first update sends every digit
+  check(led_fb_uint(led, 0, &fb, 1234, 2) == 8);
+  check(led.writes == 8);
+  // an unchanged value sends nothing
+  check(led_fb_uint(led, 0, &fb, 1234, 2) == 0);
+  check(led.writes == 8);
+  // a one digit change sends one digit
+  check(led_fb_uint(led, 0, &fb, 1235, 2) == 1);
+  check(led.writes == 9);
+  check(led.digits[0][0] == 5);
+  check(led.digits[0][2] == (2 | LED_DP));
+  // moving the decimal point sends the two digits it moved between
+  check(led_fb_uint(led, 0, &fb, 1235, 1) == 2);
+  check(led.writes == 11);
+}
+
+static void test_displays_independent() {
+  LedControl led;
+  led_fb fb[2];
+  led_fb_init(&fb[0]);
+  led_fb_init(&fb[1]);
+  check(led_fb_uint(led, 0, &fb[0], 42, 8) == 8);
+  check(led_fb_uint(led, 1, &fb[1], 42, 8) == 8);
+  check(led_fb_uint(led, 1, &fb[1], 43, 8) == 1);
+  check(led.digits[0][0] == 2 && led.digits[1][0] == 3);
+}
+
+static void test_uint_by_reference() {
+  LedControl led;
+  led_uint(led, 0, 87654321, 8);
+  check(led.writes == 8);
+  check(led.digits[0][0] == 1 && led.digits[0][7] == 8);
+}
+
+int main() {
+  test_flush_changed_digits();
+  test_displays_independent();
+  test_uint_by_reference();
+  return test_done();
+}
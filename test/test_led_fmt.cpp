@@ -0,0 +1,83 @@
+#include "host.h"
+#include "led.h"
+#include <string.h>
+
+/* the formatting led_uint() did before the fast formatters */
+static void naive_uint(byte code[8], unsigned long x, unsigned period) {
+  for (int digit = 0; digit < 8; ++digit) {
+    code[digit] = (byte)(x % 10) | ((unsigned)digit == period ? LED_DP : 0);
+    x /= 10;
+  }
+}
+
+static void test_divu10_exhaustive() {
+  // the shift-add divide used on AVR, over every 32-bit input
+  unsigned long bad = 0;
+  uint32_t n = 0;
+  do {
+    byte r;
+    uint32_t q = led_divu10_shift(n, &r);
+    bad += q != n / 10 || r != n % 10;
+  } while (++n != 0);
+  check(bad == 0);
+}
+
+static void test_uint_matches_naive() {
+  byte a[8], b[8];
+  unsigned long bad = 0;
+  for (unsigned long x = 0; x < 100000000UL; x += 997) {
+    led_fmt_uint(a, x, x % 10, false);
+    naive_uint(b, x, x % 10);
+    bad += memcmp(a, b, 8) != 0;
+  }
+  const unsigned long edges[] = { 99999999UL, 100000000UL, 0xFFFFFFFFUL, (unsigned long)-1 };
+  for (unsigned i = 0; i < sizeof(edges) / sizeof(edges[0]); ++i) {
+    led_fmt_uint(a, edges[i], 3, false);
+    naive_uint(b, edges[i], 3);
+    bad += memcmp(a, b, 8) != 0;
+  }
+  check(bad == 0);
+}
+
+/* render digit codes most significant first, '_' for blanks */
+static const char* show(const byte code[8]) {
+  static char s[17];
+  int n = 0;
+  for (int digit = 7; digit >= 0; --digit) {
+    byte v = code[digit] & ~LED_DP;
+    s[n++] = v == LED_BLANK ? '_' : v == LED_MINUS ? '-' : "0123456789ABCDEF"[v];
+    if (code[digit] & LED_DP)
+      s[n++] = '.';
+  }
+  s[n] = 0;
+  return s;
+}
+
+static void test_blanking() {
+  byte code[8];
+  led_fmt_uint(code, 42, 8, true);
+  check(strcmp(show(code), "______42") == 0);
+  led_fmt_uint(code, 0, 8, true);
+  check(strcmp(show(code), "_______0") == 0);
+  led_fmt_uint(code, 5, 2, true);
+  check(strcmp(show(code), "_____0.05") == 0);
+  led_fmt_int(code, -42, 8, true);
+  check(strcmp(show(code), "_____-42") == 0);
+  led_fmt_int(code, -5, 2, true);
+  check(strcmp(show(code), "____-0.05") == 0);
+  led_fmt_int(code, -42, 8, false);
+  check(strcmp(show(code), "-0000042") == 0);
+  led_fmt_int(code, 42, 8, true);
+  check(strcmp(show(code), "______42") == 0);
+  led_fmt_hex(code, 0xBEEF, 8, true);
+  check(strcmp(show(code), "____BEEF") == 0);
+  led_fmt_hex(code, 0x1234ABCDUL, 4, false);
+  check(strcmp(show(code), "1234.ABCD") == 0);
+}
+
+int main() {
+  test_divu10_exhaustive();
+  test_uint_matches_naive();
+  test_blanking();
+  return test_done();
+}
@@ -0,0 +1,116 @@
+#include "host.h"
+#include "rotary.h"
+
+/*
+ * Compare rotary_decode() with rotary_step() on random buffers around the
+ * vector widths, so every mix of leading sample, whole vectors and scalar
+ * tail is covered. Built once per decoder: scalar, the default SIMD and AVX2.
+ */
+
+#define MAXN 300
+
+static uint32_t x = 1;
+
+static uint32_t next(void) {
+  x ^= x << 13;
+  x ^= x >> 17;
+  x ^= x << 5;
+  return x;
+}
+
+static void fill(uint8_t* samples, size_t n, unsigned walk) {
+  uint8_t s = next() & 0x3;
+  size_t i;
+  for (i = 0; i < n; ++i) {
+    uint32_t r = next();
+    if (walk) {
+      /* mostly valid single pin changes, in long runs one way */
+      static const uint8_t gray[4] = { 0, 1, 3, 2 };
+      unsigned at = s == 0 ? 0 : s == 1 ? 1 : s == 3 ? 2 : 3;
+      s = gray[(at + ((r & 0x7) == 0 ? 3 : r & 0x10 ? 1 : 0)) & 3];
+      if ((r & 0xFF00) == 0)
+        s ^= 0x3;
+    } else {
+      s = (uint8_t)r;
+    }
+    /* bits above A and B are ignored */
+    samples[i] = (uint8_t)(s | (r >> 16 & 0xFC));
+  }
+}
+
+static unsigned check_decode(const uint8_t* samples, size_t n, uint8_t prev, int32_t pos) {
+  int32_t trace[MAXN + 1], expect[MAXN];
+  uint16_t state = prev & 0x3;
+  int32_t at = pos, got = pos;
+  uint8_t last = prev;
+  size_t i, invalid = 0, bad = 0;
+  for (i = 0; i < n; ++i) {
+    unsigned c = samples[i] & 0x3;
+    invalid += ((state & 0x3) ^ c) == 0x3;
+    at += rotary_step(&state, c >> 1, c & 1);
+    expect[i] = at;
+  }
+  trace[n] = 0x7EADBEEF;
+  bad += rotary_decode(samples, n, &last, &got, trace) != invalid;
+  bad += got != at;
+  bad += n > 0 && last != (samples[n - 1] & 0x3);
+  bad += n == 0 && last != prev;
+  bad += trace[n] != 0x7EADBEEF;
+  for (i = 0; i < n; ++i)
+    bad += trace[i] != expect[i];
+  /* without a trace */
+  last = prev;
+  got = pos;
+  bad += rotary_decode(samples, n, &last, &got, NULL) != invalid;
+  bad += got != at;
+  return (unsigned)bad;
+}
+
+static void test_lengths(void) {
+  uint8_t samples[MAXN];
+  unsigned bad = 0, round, walk;
+  size_t n;
+  for (walk = 0; walk < 2; ++walk)
+    for (round = 0; round < 200; ++round)
+      for (n = 0; n <= 72; ++n) {
+        fill(samples, n, walk);
+        bad += check_decode(samples, n, next() & 0x3, (int32_t)(next() % 100000) - 50000);
+      }
+  check(bad == 0);
+}
+
+static void test_long(void) {
+  uint8_t samples[MAXN];
+  unsigned bad = 0, round;
+  for (round = 0; round < 200; ++round) {
+    fill(samples, MAXN, round & 1);
+    bad += check_decode(samples, MAXN, next() & 0x3, (int32_t)(next() % 100000) - 50000);
+  }
+  check(bad == 0);
+}
+
+/* a steady turn one way accumulates in every vector lane */
+static void test_steady(void) {
+  static const uint8_t cw[4] = { 0, 2, 3, 1 };
+  uint8_t samples[MAXN];
+  size_t i;
+  for (i = 0; i < MAXN; ++i)
+    samples[i] = cw[(i + 1) & 3];
+  check(check_decode(samples, MAXN, 0, 0) == 0);
+}
+
+int main(void) {
+  test_lengths();
+  test_long();
+  test_steady();
+#if defined(ROTARY_AVX2)
+  printf("rotary_decode: AVX2\n");
+#elif defined(ROTARY_SSE2)
+  printf("rotary_decode: SSE2\n");
+#elif defined(ROTARY_NEON)
+  printf("rotary_decode: NEON\n");
+#else
+  printf("rotary_decode: scalar\n");
+#endif
+  return test_done();
+}
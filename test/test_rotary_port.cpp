@@ -0,0 +1,51 @@
+#include "host.h"
+#include "rotary.h"
+
+// the documented interrupt usage, which must build as C++ too
+static volatile uint16_t rot_port;
+static volatile int rot_pos[4];
+
+static void rot_isr(uint16_t pins) {
+  rotary_port_step(&rot_port, pins, rot_pos, 4);
+}
+
+static void test_matches_rotary_step() {
+  uint16_t state[4] = { 0, 0, 0, 0 };
+  int pos[4] = { 0, 0, 0, 0 };
+  uint32_t x = 1;
+  unsigned bad = 0;
+  for (unsigned i = 0; i < 10000; ++i) {
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    // mostly single pin changes, as a turning encoder gives
+    uint16_t pins = rot_port ^ (uint16_t)(1u << (x % 8));
+    if (x & 0x100)
+      pins ^= (uint16_t)(x >> 16);
+    pins &= 0xFF;
+    rot_isr(pins);
+    for (unsigned e = 0; e < 4; ++e)
+      pos[e] += rotary_step(&state[e], (pins >> (2 * e + 1)) & 1, (pins >> (2 * e)) & 1);
+    for (unsigned e = 0; e < 4; ++e)
+      bad += rot_pos[e] != pos[e];
+  }
+  check(bad == 0);
+  check(rot_pos[0] != 0 || rot_pos[3] != 0);
+}
+
+static void test_unchanged_port() {
+  uint16_t prev = 0x01;
+  int pos[2] = { 5, 7 };
+  rotary_port_step(&prev, 0x01, pos, 2);
+  check(pos[0] == 5 && pos[1] == 7);
+  // one quarter step of encoder 1 from 00 to 01 is counterclockwise
+  rotary_port_step(&prev, 0x05, pos, 2);
+  check(prev == 0x05);
+  check(pos[0] == 5 && pos[1] == 6);
+}
+
+int main() {
+  test_matches_rotary_step();
+  test_unchanged_port();
+  return test_done();
+}
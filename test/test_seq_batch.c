@@ -0,0 +1,86 @@
+#include "host.h"
+#include "seq_count.h"
+
+/* pull batches of up to 'cap' elements, recording each batch size */
+static int batches(struct count* src, size_t cap, size_t* sizes, int* ok) {
+  int buf[8], nb = 0, expect = 1;
+  generator k;
+  do {
+    size_t n = cap, i;
+    k = seq_next_n(count_n, src, buf, &n);
+    for (i = 0; i < n; ++i)
+      *ok &= buf[i] == expect++;
+    sizes[nb++] = n;
+  } while (k != SEQ_DONE);
+  *ok &= expect == src->n + 1;
+  return nb;
+}
+
+static void test_partial_last_batch(void) {
+  struct count src;
+  size_t sizes[8], n = 4;
+  int buf[4], ok = 1;
+  count_init(&src, 10);
+  check(batches(&src, 4, sizes, &ok) == 3);
+  check(ok);
+  check(sizes[0] == 4 && sizes[1] == 4 && sizes[2] == 2);
+  /* a finished generator fills nothing */
+  check(seq_next_n(count_n, &src, buf, &n) == SEQ_DONE);
+  check(n == 0);
+}
+
+static void test_empty_batch_on_completion(void) {
+  struct count src;
+  size_t sizes[8];
+  int ok = 1;
+  /* the last full batch doesn't know the generator is done */
+  count_init(&src, 8);
+  check(batches(&src, 4, sizes, &ok) == 3);
+  check(ok);
+  check(sizes[0] == 4 && sizes[1] == 4 && sizes[2] == 0);
+}
+
+static void test_single_element_batches(void) {
+  struct count src;
+  size_t sizes[8];
+  int ok = 1;
+  count_init(&src, 3);
+  check(batches(&src, 1, sizes, &ok) == 4);
+  check(ok);
+  check(sizes[3] == 0);
+}
+
+static void test_empty_generator(void) {
+  struct count src;
+  size_t sizes[8];
+  int ok = 1;
+  count_init(&src, 0);
+  check(batches(&src, 4, sizes, &ok) == 1);
+  check(ok);
+  check(sizes[0] == 0);
+}
+
+static void test_fill(void) {
+  struct count src;
+  int buf[4];
+  size_t n;
+  count_init(&src, 6);
+  n = 4;
+  check(seq_fill((seq_fn)count, (seq*)&src, buf, sizeof(int), &n) != SEQ_DONE);
+  check(n == 4 && buf[0] == 1 && buf[3] == 4);
+  n = 4;
+  check(seq_fill((seq_fn)count, (seq*)&src, buf, sizeof(int), &n) == SEQ_DONE);
+  check(n == 2 && buf[0] == 5 && buf[1] == 6);
+  n = 4;
+  check(seq_fill((seq_fn)count, (seq*)&src, buf, sizeof(int), &n) == SEQ_DONE);
+  check(n == 0);
+}
+
+int main(void) {
+  test_partial_last_batch();
+  test_empty_batch_on_completion();
+  test_single_element_batches();
+  test_empty_generator();
+  test_fill();
+  return test_done();
+}
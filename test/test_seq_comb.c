@@ -0,0 +1,169 @@
+#include "host.h"
+#include "seq_count.h"
+#include <stddef.h>
+
+static void test_static_filter_take_skip(void) {
+  struct count src;
+  int x, sum, n;
+
+  count_init(&src, 10);
+  sum = 0;
+  seq_for_filter(count, &src, x, x % 2 == 0) {
+    sum += x;
+  }
+  check(sum == 30);
+
+  count_init(&src, 10);
+  sum = n = 0;
+  seq_for_take(count, &src, x, 3) {
+    sum += x;
+    ++n;
+  }
+  check(sum == 6 && n == 3);
+  /* the source resumes after the taken elements */
+  check(seq_next(count, &src, &x) && x == 4);
+
+  count_init(&src, 2);
+  n = 0;
+  seq_for_take(count, &src, x, 5) {
+    ++n;
+  }
+  check(n == 2);
+
+  count_init(&src, 10);
+  sum = n = 0;
+  seq_for_skip(count, &src, x, 7) {
+    sum += x;
+    ++n;
+  }
+  check(sum == 27 && n == 3);
+
+  count_init(&src, 3);
+  n = 0;
+  seq_for_skip(count, &src, x, 5) {
+    ++n;
+  }
+  check(n == 0);
+}
+
+static void test_static_zip_fold(void) {
+  struct count a, b;
+  int x, y, n = 0, dot = 0;
+  count_init(&a, 4);
+  count_init(&b, 6);
+  seq_for_zip(count, &a, x, count, &b, y) {
+    dot += x * y;
+    ++n;
+  }
+  check(n == 4 && dot == 30);
+
+  count_init(&a, 5);
+  dot = 1;
+  seq_fold(count, &a, x, dot, dot * x);
+  check(dot == 120);
+}
+
+static void test_static_window(void) {
+  struct count src;
+  int w[3], n = 0, ok = 1;
+  count_init(&src, 6);
+  seq_for_window(count, &src, w, 3) {
+    /* oldest first: n+1, n+2, n+3 */
+    ok &= w[0] == n + 1 && w[1] == n + 2 && w[2] == n + 3;
+    ++n;
+  }
+  check(ok);
+  check(n == 4);
+
+  /* too few elements for a full window */
+  count_init(&src, 2);
+  n = 0;
+  seq_for_window(count, &src, w, 3) {
+    ++n;
+  }
+  check(n == 0);
+
+  /* a window of one is every element */
+  count_init(&src, 4);
+  n = 0;
+  seq_for_window(count, &src, w, 1) {
+    ok &= w[0] == ++n;
+  }
+  check(ok && n == 4);
+}
+
+static unsigned odd(const void* x) {
+  return *(const int*)x % 2;
+}
+
+static void add(void* acc, const void* x) {
+  *(int*)acc += *(const int*)x;
+}
+
+static void test_dynamic(void) {
+  struct count src, src2;
+  struct seq_filter f;
+  struct seq_take t;
+  struct seq_skip s;
+  struct seq_zip z;
+  struct seq_window w;
+  struct pair { int a; int b; } pair;
+  dseq d, d2;
+  int x, sum, n, ok;
+  void* win;
+
+  /* odd elements, after the first two, at most three: 5, 7, 9 */
+  count_init(&src, 20);
+  dseq_init((seq_fn)count, (seq*)&src, &d);
+  filter_dseq(&d, odd, &f);
+  dseq_init((seq_fn)filter_next, (seq*)&f, &d);
+  skip_dseq(&d, 2, &s);
+  dseq_init((seq_fn)skip_next, (seq*)&s, &d);
+  take_dseq(&d, 3, &t);
+  dseq_init((seq_fn)take_next, (seq*)&t, &d);
+  sum = 0;
+  fold_dseq(&d, add, &sum, &x);
+  check(sum == 21);
+
+  /* skipping past the end */
+  count_init(&src, 3);
+  dseq_init((seq_fn)count, (seq*)&src, &d);
+  skip_dseq(&d, 5, &s);
+  check(seq_next(skip_next, &s, &x) == SEQ_DONE);
+
+  count_init(&src, 3);
+  count_init(&src2, 5);
+  dseq_init((seq_fn)count, (seq*)&src, &d);
+  dseq_init((seq_fn)count, (seq*)&src2, &d2);
+  zip_dseq(&d, &d2, offsetof(struct pair, b), &z);
+  n = 0;
+  ok = 1;
+  while (seq_next(zip_next, &z, &pair)) {
+    ++n;
+    ok &= pair.a == n && pair.b == n;
+  }
+  check(ok && n == 3);
+
+  {
+    int buf[3];
+    count_init(&src, 5);
+    dseq_init((seq_fn)count, (seq*)&src, &d);
+    window_dseq(&d, buf, sizeof(int), 3, &w);
+    n = 0;
+    ok = 1;
+    while (seq_next(window_next, &w, &win)) {
+      int* v = (int*)win;
+      ok &= v[0] == n + 1 && v[1] == n + 2 && v[2] == n + 3;
+      ++n;
+    }
+    check(ok && n == 3);
+  }
+}
+
+int main(void) {
+  test_static_filter_take_skip();
+  test_static_zip_fold();
+  test_static_window();
+  test_dynamic();
+  return test_done();
+}
@@ -0,0 +1,106 @@
+#include "host.h"
+#include "seq_count.h"
+
+/* stages that map in place */
+static void* add1(void* x) {
+  *(int*)x += 1;
+  return x;
+}
+
+static void* twice(void* x) {
+  *(int*)x *= 2;
+  return x;
+}
+
+/* a stage that maps into its own buffer */
+static int negated;
+static void* negate(void* x) {
+  negated = -*(int*)x;
+  return &negated;
+}
+
+/* built in test_seq_map_other.c, where map_next has a different address */
+struct seq_map* other_map(struct count* src, void* tmp);
+
+/* sum a map sequence's values, checking the element count */
+static long sum_map(struct seq_map* m, int* count) {
+  long sum = 0;
+  void* x;
+  *count = 0;
+  while (seq_next(map_next, m, &x)) {
+    sum += *(int*)x;
+    ++*count;
+  }
+  return sum;
+}
+
+static void test_fused_depths(void) {
+  int depth;
+  /* depths past SEQ_MAP_MAX nest a full map */
+  for (depth = 1; depth <= SEQ_MAP_MAX + 2; ++depth) {
+    struct count src;
+    struct seq_map maps[SEQ_MAP_MAX + 2];
+    int tmp[SEQ_MAP_MAX + 2][2];
+    int d, n;
+    count_init(&src, 10);
+    map_seq((generator (*)(void*, void*))count, (seq*)&src, add1, tmp[0], &maps[0]);
+    for (d = 1; d < depth; ++d) {
+      dseq inner;
+      dseq_init((seq_fn)map_next, (seq*)&maps[d - 1], &inner);
+      map_dseq(&inner, add1, tmp[d], &maps[d]);
+    }
+    /* fused up to SEQ_MAP_MAX stages, then one nesting level */
+    check(maps[depth - 1].n == (depth <= SEQ_MAP_MAX ? (unsigned)depth : (unsigned)depth - SEQ_MAP_MAX + 1));
+    check(sum_map(&maps[depth - 1], &n) == 55 + 10 * depth);
+    check(n == 10);
+  }
+}
+
+static void test_stage_order(void) {
+  struct count src;
+  struct seq_map a, b, c;
+  dseq d;
+  int tmp[2], n;
+  count_init(&src, 3);
+  map_seq((generator (*)(void*, void*))count, (seq*)&src, add1, tmp, &a);
+  dseq_init((seq_fn)map_next, (seq*)&a, &d);
+  map_dseq(&d, twice, tmp, &b);
+  dseq_init((seq_fn)map_next, (seq*)&b, &d);
+  map_dseq(&d, negate, tmp, &c);
+  /* -(2 * (x + 1)) for 1, 2, 3 */
+  check(sum_map(&c, &n) == -18);
+  check(n == 3);
+}
+
+static void test_plain_source(void) {
+  struct count src;
+  struct seq_map m;
+  dseq d;
+  int tmp[2], n;
+  count_init(&src, 4);
+  dseq_init((seq_fn)count, (seq*)&src, &d);
+  map_dseq(&d, twice, tmp, &m);
+  check(m.n == 1);
+  check(sum_map(&m, &n) == 20);
+  check(n == 4);
+}
+
+static void test_map_from_other_file(void) {
+  struct count src;
+  struct seq_map m;
+  int tmp[2], tmp2[2], n;
+  count_init(&src, 5);
+  map_map(other_map(&src, tmp), twice, tmp2, &m);
+  /* other_map adds 1, and the stages are fused */
+  check(m.n == 2);
+  check(sum_map(&m, &n) == 40);
+  check(n == 5);
+}
+
+int main(void) {
+  test_fused_depths();
+  test_stage_order();
+  test_plain_source();
+  test_map_from_other_file();
+  return test_done();
+}
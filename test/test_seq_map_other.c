@@ -0,0 +1,12 @@
+#include "seq_count.h"
+
+static void* add1(void* x) {
+  *(int*)x += 1;
+  return x;
+}
+
+struct seq_map* other_map(struct count* src, void* tmp) {
+  static struct seq_map m;
+  map_seq((generator (*)(void*, void*))count, (seq*)src, add1, tmp, &m);
+  return &m;
+}
@@ -0,0 +1,78 @@
+#include "host.h"
+#include "seq_count.h"
+#include <vector>
+
+static void test_range_for() {
+  struct count src;
+  count_init(&src, 5);
+  int sum = 0, n = 0;
+  for (int x : seq_range_of(count, &src)) {
+    sum += x;
+    ++n;
+  }
+  check(sum == 15 && n == 5);
+  // the range is single pass
+  n = 0;
+  for (int x : seq_range_of(count, &src)) {
+    (void)x;
+    ++n;
+  }
+  check(n == 0);
+}
+
+static void test_empty_and_break() {
+  struct count src;
+  count_init(&src, 0);
+  auto r = seq_range_of(count, &src);
+  check(r.begin() == r.end());
+
+  count_init(&src, 10);
+  int last = 0;
+  for (int x : seq_range_of(count, &src)) {
+    last = x;
+    if (x == 3)
+      break;
+  }
+  check(last == 3);
+  // a new range resumes after the element that ended the loop
+  check(*seq_range_of(count, &src).begin() == 4);
+}
+
+static void test_iterator_algorithms() {
+  struct count src;
+  count_init(&src, 4);
+  auto r = seq_range_of(count, &src);
+  std::vector<int> v(r.begin(), r.end());
+  check(v.size() == 4 && v[0] == 1 && v[3] == 4);
+}
+
+#if __cplusplus >= 202002L
+static_assert(std::ranges::view<seq_range<decltype(&count), &count>>);
+static_assert(std::ranges::input_range<seq_range<decltype(&count), &count>>);
+
+static void test_views() {
+  struct count src;
+  count_init(&src, 20);
+  int sum = 0, n = 0;
+  auto odd_squares = seq_range_of(count, &src)
+      | std::views::filter([](int x) { return x % 2; })
+      | std::views::transform([](int x) { return x * x; })
+      | std::views::take(3);
+  for (int x : odd_squares) {
+    sum += x;
+    ++n;
+  }
+  // 1 + 9 + 25
+  check(sum == 35 && n == 3);
+}
+#endif
+
+int main() {
+  test_range_for();
+  test_empty_and_break();
+  test_iterator_algorithms();
+#if __cplusplus >= 202002L
+  test_views();
+#endif
+  return test_done();
+}